@@ -0,0 +1,636 @@
+//|___________________________________________________________________
+//!
+//! \file batch_xform.cpp
+//!
+//! \brief Batch versions of the gmtl transforms the renderer uses.
+//!
+//! Matrices are column-major (gmtl's mData), so column k of m starts at
+//! m[4 * k]. The SIMD kernels keep whole columns in registers and
+//! broadcast the other operand's elements across them.
+//|___________________________________________________________________
+
+//|___________________
+//|
+//| Includes
+//|___________________
+
+#include "batch_xform.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define BATCH_X86
+#endif
+
+#ifdef BATCH_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// MSVC compiles intrinsics for any instruction set as is; GCC and Clang
+// need each kernel tagged with the instructions it may use
+#if defined(BATCH_X86) && defined(__GNUC__)
+#define BATCH_TARGET_SSE  __attribute__((target("sse2")))
+#define BATCH_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define BATCH_TARGET_SSE
+#define BATCH_TARGET_AVX2
+#endif
+
+// Point and vector arrays are walked as packed float triples
+static_assert(sizeof(gmtl::Point3f) == 3 * sizeof(float), "Point3f must be 3 packed floats");
+static_assert(sizeof(gmtl::Vec3f) == 3 * sizeof(float), "Vec3f must be 3 packed floats");
+
+//|___________________
+//|
+//| Types
+//|___________________
+
+typedef void (*XformKernel)(const float* m, const float* in, float* out, size_t count);
+typedef void (*ComposeKernel)(const gmtl::Matrix44f* lhs, const gmtl::Matrix44f* rhs, gmtl::Matrix44f* out, size_t count);
+typedef void (*InvertKernel)(const gmtl::Matrix44f* in, gmtl::Matrix44f* out, size_t count);
+
+struct BatchKernels
+{
+	XformKernel points;
+	XformKernel vectors;
+	ComposeKernel compose;
+	InvertKernel invert;
+};
+
+//|____________________________________________________________________
+//|
+//| Function: ComposedState
+//|
+//! \param lhs   [in] State of the left matrix.
+//! \param rhs   [in] State of the right matrix.
+//! \return A valid gmtl state for lhs * rhs.
+//!
+//! Conservative: products of affine matrices are marked AFFINE (keeping
+//! NON_UNISCALE), so gmtl::invert() later picks a correct, if not always
+//! the cheapest, method.
+//|____________________________________________________________________
+
+static int ComposedState(int lhs, int rhs)
+{
+	if ((lhs | rhs) & (gmtl::Matrix44f::FULL | gmtl::Matrix44f::XFORM_ERROR))
+		return gmtl::Matrix44f::FULL;
+	if (lhs == gmtl::Matrix44f::IDENTITY)
+		return rhs;
+	if (rhs == gmtl::Matrix44f::IDENTITY)
+		return lhs;
+	return gmtl::Matrix44f::AFFINE | ((lhs | rhs) & gmtl::Matrix44f::NON_UNISCALE);
+}
+
+//|___________________
+//|
+//| Scalar kernels
+//|___________________
+
+static void XformPointsScalar(const float* m, const float* in, float* out, size_t count)
+{
+	for (size_t i = 0; i < count; i++, in += 3, out += 3) {
+		const float x = in[0], y = in[1], z = in[2];
+		out[0] = m[0] * x + m[4] * y + m[8] * z + m[12];
+		out[1] = m[1] * x + m[5] * y + m[9] * z + m[13];
+		out[2] = m[2] * x + m[6] * y + m[10] * z + m[14];
+	}
+}
+
+static void XformVectorsScalar(const float* m, const float* in, float* out, size_t count)
+{
+	for (size_t i = 0; i < count; i++, in += 3, out += 3) {
+		const float x = in[0], y = in[1], z = in[2];
+		out[0] = m[0] * x + m[4] * y + m[8] * z;
+		out[1] = m[1] * x + m[5] * y + m[9] * z;
+		out[2] = m[2] * x + m[6] * y + m[10] * z;
+	}
+}
+
+static void ComposeScalar(const gmtl::Matrix44f* lhs, const gmtl::Matrix44f* rhs, gmtl::Matrix44f* out, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		const float* a = lhs[i].mData;
+		const float* b = rhs[i].mData;
+		float r[16];
+
+		for (int col = 0; col < 4; col++)
+			for (int row = 0; row < 4; row++)
+				r[col * 4 + row] = a[row] * b[col * 4] + a[4 + row] * b[col * 4 + 1]
+					+ a[8 + row] * b[col * 4 + 2] + a[12 + row] * b[col * 4 + 3];
+
+		const int state = ComposedState(lhs[i].getState(), rhs[i].getState());
+		for (int k = 0; k < 16; k++)
+			out[i].mData[k] = r[k];
+		out[i].setState(state);
+	}
+}
+
+static void InvertRigidScalar(const gmtl::Matrix44f* in, gmtl::Matrix44f* out, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		const float* m = in[i].mData;
+		float r[16];
+
+		// Rotation part is transposed
+		for (int col = 0; col < 3; col++) {
+			for (int row = 0; row < 3; row++)
+				r[col * 4 + row] = m[row * 4 + col];
+			r[col * 4 + 3] = 0.0f;
+		}
+
+		// Translation becomes -R^T t
+		for (int row = 0; row < 3; row++)
+			r[12 + row] = -(r[row] * m[12] + r[4 + row] * m[13] + r[8 + row] * m[14]);
+		r[15] = 1.0f;
+
+		const int state = in[i].getState();
+		for (int k = 0; k < 16; k++)
+			out[i].mData[k] = r[k];
+		out[i].setState(state);
+	}
+}
+
+static const BatchKernels SCALAR_KERNELS = {
+	XformPointsScalar, XformVectorsScalar, ComposeScalar, InvertRigidScalar
+};
+
+#ifdef BATCH_X86
+
+//|___________________
+//|
+//| SSE kernels
+//|___________________
+
+// Writes x, y, z of v without touching the float after them
+BATCH_TARGET_SSE static inline void Store3(float* out, __m128 v)
+{
+	_mm_storel_pi((__m64*)out, v);
+	_mm_store_ss(out + 2, _mm_movehl_ps(v, v));
+}
+
+BATCH_TARGET_SSE static void XformPointsSSE(const float* m, const float* in, float* out, size_t count)
+{
+	const __m128 c0 = _mm_loadu_ps(m);
+	const __m128 c1 = _mm_loadu_ps(m + 4);
+	const __m128 c2 = _mm_loadu_ps(m + 8);
+	const __m128 c3 = _mm_loadu_ps(m + 12);
+
+	for (size_t i = 0; i < count; i++, in += 3, out += 3) {
+		const __m128 xy = _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(in[0])), _mm_mul_ps(c1, _mm_set1_ps(in[1])));
+		const __m128 zw = _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(in[2])), c3);
+		Store3(out, _mm_add_ps(xy, zw));
+	}
+}
+
+BATCH_TARGET_SSE static void XformVectorsSSE(const float* m, const float* in, float* out, size_t count)
+{
+	const __m128 c0 = _mm_loadu_ps(m);
+	const __m128 c1 = _mm_loadu_ps(m + 4);
+	const __m128 c2 = _mm_loadu_ps(m + 8);
+
+	for (size_t i = 0; i < count; i++, in += 3, out += 3) {
+		const __m128 xy = _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(in[0])), _mm_mul_ps(c1, _mm_set1_ps(in[1])));
+		Store3(out, _mm_add_ps(xy, _mm_mul_ps(c2, _mm_set1_ps(in[2]))));
+	}
+}
+
+BATCH_TARGET_SSE static void ComposeSSE(const gmtl::Matrix44f* lhs, const gmtl::Matrix44f* rhs, gmtl::Matrix44f* out, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		const float* a = lhs[i].mData;
+		const float* b = rhs[i].mData;
+		const __m128 a0 = _mm_loadu_ps(a);
+		const __m128 a1 = _mm_loadu_ps(a + 4);
+		const __m128 a2 = _mm_loadu_ps(a + 8);
+		const __m128 a3 = _mm_loadu_ps(a + 12);
+
+		// Column j of the product mixes lhs's columns by column j of rhs
+		__m128 r[4];
+		for (int j = 0; j < 4; j++) {
+			const __m128 c01 = _mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(b[4 * j])), _mm_mul_ps(a1, _mm_set1_ps(b[4 * j + 1])));
+			const __m128 c23 = _mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(b[4 * j + 2])), _mm_mul_ps(a3, _mm_set1_ps(b[4 * j + 3])));
+			r[j] = _mm_add_ps(c01, c23);
+		}
+
+		const int state = ComposedState(lhs[i].getState(), rhs[i].getState());
+		float* o = out[i].mData;
+		_mm_storeu_ps(o, r[0]);
+		_mm_storeu_ps(o + 4, r[1]);
+		_mm_storeu_ps(o + 8, r[2]);
+		_mm_storeu_ps(o + 12, r[3]);
+		out[i].setState(state);
+	}
+}
+
+BATCH_TARGET_SSE static void InvertRigidSSE(const gmtl::Matrix44f* in, gmtl::Matrix44f* out, size_t count)
+{
+	const __m128 xyz_mask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+	const __m128 w_one = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+
+	for (size_t i = 0; i < count; i++) {
+		const float* m = in[i].mData;
+		__m128 r0 = _mm_loadu_ps(m);
+		__m128 r1 = _mm_loadu_ps(m + 4);
+		__m128 r2 = _mm_loadu_ps(m + 8);
+		__m128 r3 = _mm_loadu_ps(m + 12);
+
+		// Columns become rows: rk = (R_k0, R_k1, R_k2, t_k), which is column k of R^T
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+		const __m128 tx = _mm_shuffle_ps(r0, r0, _MM_SHUFFLE(3, 3, 3, 3));
+		const __m128 ty = _mm_shuffle_ps(r1, r1, _MM_SHUFFLE(3, 3, 3, 3));
+		const __m128 tz = _mm_shuffle_ps(r2, r2, _MM_SHUFFLE(3, 3, 3, 3));
+		r0 = _mm_and_ps(r0, xyz_mask);
+		r1 = _mm_and_ps(r1, xyz_mask);
+		r2 = _mm_and_ps(r2, xyz_mask);
+
+		// -R^T t = -(t_x * col0 + t_y * col1 + t_z * col2) of R^T, w = 1
+		const __m128 rt = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r0, tx), _mm_mul_ps(r1, ty)), _mm_mul_ps(r2, tz));
+		const __m128 c3 = _mm_sub_ps(w_one, rt);
+
+		const int state = in[i].getState();
+		float* o = out[i].mData;
+		_mm_storeu_ps(o, r0);
+		_mm_storeu_ps(o + 4, r1);
+		_mm_storeu_ps(o + 8, r2);
+		_mm_storeu_ps(o + 12, c3);
+		out[i].setState(state);
+	}
+}
+
+static const BatchKernels SSE_KERNELS = {
+	XformPointsSSE, XformVectorsSSE, ComposeSSE, InvertRigidSSE
+};
+
+//|___________________
+//|
+//| AVX2 kernels
+//|___________________
+//
+// 256-bit registers hold two 4-float columns side by side, one per
+// 128-bit lane. Shuffles and permutes act per lane, so the SSE
+// algorithms run unchanged on two points, columns or matrices at once.
+
+// Splits two lanes into two float triples
+BATCH_TARGET_AVX2 static inline void Store3x2(float* out, __m256 v)
+{
+	const __m128 lo = _mm256_castps256_ps128(v);
+	const __m128 hi = _mm256_extractf128_ps(v, 1);
+	_mm_storel_pi((__m64*)out, lo);
+	_mm_store_ss(out + 2, _mm_movehl_ps(lo, lo));
+	_mm_storel_pi((__m64*)(out + 3), hi);
+	_mm_store_ss(out + 5, _mm_movehl_ps(hi, hi));
+}
+
+// Loads points i and i + 1 as [x0 y0 z0 x1 | z0 x1 y1 z1], reading no
+// further than the second point
+BATCH_TARGET_AVX2 static inline __m256 LoadPointPair(const float* in)
+{
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(in)), _mm_loadu_ps(in + 2), 1);
+}
+
+BATCH_TARGET_AVX2 static void XformPointsAVX2(const float* m, const float* in, float* out, size_t count)
+{
+	const __m256 c0 = _mm256_broadcast_ps((const __m128*)m);
+	const __m256 c1 = _mm256_broadcast_ps((const __m128*)(m + 4));
+	const __m256 c2 = _mm256_broadcast_ps((const __m128*)(m + 8));
+	const __m256 c3 = _mm256_broadcast_ps((const __m128*)(m + 12));
+
+	// Where x, y, z sit in each lane of LoadPointPair()
+	const __m256i x_idx = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+	const __m256i y_idx = _mm256_setr_epi32(1, 1, 1, 1, 2, 2, 2, 2);
+	const __m256i z_idx = _mm256_setr_epi32(2, 2, 2, 2, 3, 3, 3, 3);
+
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2, in += 6, out += 6) {
+		const __m256 p = LoadPointPair(in);
+		__m256 r = _mm256_fmadd_ps(c2, _mm256_permutevar_ps(p, z_idx), c3);
+		r = _mm256_fmadd_ps(c1, _mm256_permutevar_ps(p, y_idx), r);
+		r = _mm256_fmadd_ps(c0, _mm256_permutevar_ps(p, x_idx), r);
+		Store3x2(out, r);
+	}
+
+	if (i < count) {
+		__m128 r = _mm_fmadd_ps(_mm256_castps256_ps128(c2), _mm_set1_ps(in[2]), _mm256_castps256_ps128(c3));
+		r = _mm_fmadd_ps(_mm256_castps256_ps128(c1), _mm_set1_ps(in[1]), r);
+		r = _mm_fmadd_ps(_mm256_castps256_ps128(c0), _mm_set1_ps(in[0]), r);
+		Store3(out, r);
+	}
+}
+
+BATCH_TARGET_AVX2 static void XformVectorsAVX2(const float* m, const float* in, float* out, size_t count)
+{
+	const __m256 c0 = _mm256_broadcast_ps((const __m128*)m);
+	const __m256 c1 = _mm256_broadcast_ps((const __m128*)(m + 4));
+	const __m256 c2 = _mm256_broadcast_ps((const __m128*)(m + 8));
+
+	const __m256i x_idx = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+	const __m256i y_idx = _mm256_setr_epi32(1, 1, 1, 1, 2, 2, 2, 2);
+	const __m256i z_idx = _mm256_setr_epi32(2, 2, 2, 2, 3, 3, 3, 3);
+
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2, in += 6, out += 6) {
+		const __m256 p = LoadPointPair(in);
+		__m256 r = _mm256_mul_ps(c2, _mm256_permutevar_ps(p, z_idx));
+		r = _mm256_fmadd_ps(c1, _mm256_permutevar_ps(p, y_idx), r);
+		r = _mm256_fmadd_ps(c0, _mm256_permutevar_ps(p, x_idx), r);
+		Store3x2(out, r);
+	}
+
+	if (i < count) {
+		__m128 r = _mm_mul_ps(_mm256_castps256_ps128(c2), _mm_set1_ps(in[2]));
+		r = _mm_fmadd_ps(_mm256_castps256_ps128(c1), _mm_set1_ps(in[1]), r);
+		r = _mm_fmadd_ps(_mm256_castps256_ps128(c0), _mm_set1_ps(in[0]), r);
+		Store3(out, r);
+	}
+}
+
+BATCH_TARGET_AVX2 static void ComposeAVX2(const gmtl::Matrix44f* lhs, const gmtl::Matrix44f* rhs, gmtl::Matrix44f* out, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		const float* a = lhs[i].mData;
+		const float* b = rhs[i].mData;
+		const __m256 a0 = _mm256_broadcast_ps((const __m128*)a);
+		const __m256 a1 = _mm256_broadcast_ps((const __m128*)(a + 4));
+		const __m256 a2 = _mm256_broadcast_ps((const __m128*)(a + 8));
+		const __m256 a3 = _mm256_broadcast_ps((const __m128*)(a + 12));
+
+		// Two columns of rhs per register; permute broadcasts element k within each lane
+		const __m256 b01 = _mm256_loadu_ps(b);
+		const __m256 b23 = _mm256_loadu_ps(b + 8);
+
+		__m256 r01 = _mm256_mul_ps(a0, _mm256_permute_ps(b01, 0x00));
+		r01 = _mm256_fmadd_ps(a1, _mm256_permute_ps(b01, 0x55), r01);
+		r01 = _mm256_fmadd_ps(a2, _mm256_permute_ps(b01, 0xAA), r01);
+		r01 = _mm256_fmadd_ps(a3, _mm256_permute_ps(b01, 0xFF), r01);
+
+		__m256 r23 = _mm256_mul_ps(a0, _mm256_permute_ps(b23, 0x00));
+		r23 = _mm256_fmadd_ps(a1, _mm256_permute_ps(b23, 0x55), r23);
+		r23 = _mm256_fmadd_ps(a2, _mm256_permute_ps(b23, 0xAA), r23);
+		r23 = _mm256_fmadd_ps(a3, _mm256_permute_ps(b23, 0xFF), r23);
+
+		const int state = ComposedState(lhs[i].getState(), rhs[i].getState());
+		_mm256_storeu_ps(out[i].mData, r01);
+		_mm256_storeu_ps(out[i].mData + 8, r23);
+		out[i].setState(state);
+	}
+}
+
+// Column k of matrices a and b, side by side
+BATCH_TARGET_AVX2 static inline __m256 LoadColumnPair(const float* a, const float* b, int k)
+{
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(a + 4 * k)), _mm_loadu_ps(b + 4 * k), 1);
+}
+
+BATCH_TARGET_AVX2 static inline void StoreColumnPair(float* a, float* b, int k, __m256 v)
+{
+	_mm_storeu_ps(a + 4 * k, _mm256_castps256_ps128(v));
+	_mm_storeu_ps(b + 4 * k, _mm256_extractf128_ps(v, 1));
+}
+
+BATCH_TARGET_AVX2 static void InvertRigidAVX2(const gmtl::Matrix44f* in, gmtl::Matrix44f* out, size_t count)
+{
+	const __m256 xyz_mask = _mm256_castsi256_ps(_mm256_setr_epi32(-1, -1, -1, 0, -1, -1, -1, 0));
+	const __m256 w_one = _mm256_setr_ps(0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2) {
+		const float* ma = in[i].mData;
+		const float* mb = in[i + 1].mData;
+		const __m256 c0 = LoadColumnPair(ma, mb, 0);
+		const __m256 c1 = LoadColumnPair(ma, mb, 1);
+		const __m256 c2 = LoadColumnPair(ma, mb, 2);
+		const __m256 c3 = LoadColumnPair(ma, mb, 3);
+
+		// _MM_TRANSPOSE4_PS in both lanes; the 4th row (0 0 0 1) is not needed
+		const __m256 t0 = _mm256_unpacklo_ps(c0, c1);
+		const __m256 t1 = _mm256_unpackhi_ps(c0, c1);
+		const __m256 t2 = _mm256_unpacklo_ps(c2, c3);
+		const __m256 t3 = _mm256_unpackhi_ps(c2, c3);
+		__m256 r0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 r1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+		__m256 r2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+
+		const __m256 tx = _mm256_permute_ps(r0, 0xFF);
+		const __m256 ty = _mm256_permute_ps(r1, 0xFF);
+		const __m256 tz = _mm256_permute_ps(r2, 0xFF);
+		r0 = _mm256_and_ps(r0, xyz_mask);
+		r1 = _mm256_and_ps(r1, xyz_mask);
+		r2 = _mm256_and_ps(r2, xyz_mask);
+
+		__m256 rt = _mm256_mul_ps(r0, tx);
+		rt = _mm256_fmadd_ps(r1, ty, rt);
+		rt = _mm256_fmadd_ps(r2, tz, rt);
+		const __m256 r3 = _mm256_sub_ps(w_one, rt);
+
+		const int state_a = in[i].getState();
+		const int state_b = in[i + 1].getState();
+		float* oa = out[i].mData;
+		float* ob = out[i + 1].mData;
+		StoreColumnPair(oa, ob, 0, r0);
+		StoreColumnPair(oa, ob, 1, r1);
+		StoreColumnPair(oa, ob, 2, r2);
+		StoreColumnPair(oa, ob, 3, r3);
+		out[i].setState(state_a);
+		out[i + 1].setState(state_b);
+	}
+
+	if (i < count)
+		InvertRigidSSE(in + i, out + i, count - i);
+}
+
+static const BatchKernels AVX2_KERNELS = {
+	XformPointsAVX2, XformVectorsAVX2, ComposeAVX2, InvertRigidAVX2
+};
+
+//|____________________________________________________________________
+//|
+//| Function: CpuHasAVX2 / CpuHasSSE2
+//|
+//! AVX2 also needs FMA, and the OS must save the YMM registers on a
+//! context switch (OSXSAVE set and XCR0 enabling SSE and AVX state).
+//|____________________________________________________________________
+
+static void Cpuid(int regs[4], int leaf)
+{
+#ifdef _MSC_VER
+	__cpuidex(regs, leaf, 0);
+#else
+	unsigned int a = 0, b = 0, c = 0, d = 0;
+	__cpuid_count(leaf, 0, a, b, c, d);
+	regs[0] = (int)a;
+	regs[1] = (int)b;
+	regs[2] = (int)c;
+	regs[3] = (int)d;
+#endif
+}
+
+static unsigned long long Xgetbv0()
+{
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	unsigned int lo = 0, hi = 0;
+	__asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	return ((unsigned long long)hi << 32) | lo;
+#endif
+}
+
+static bool CpuHasSSE2()
+{
+	int regs[4];
+	Cpuid(regs, 1);
+	return (regs[3] & (1 << 26)) != 0;
+}
+
+static bool CpuHasAVX2()
+{
+	int regs[4];
+	Cpuid(regs, 0);
+	if (regs[0] < 7)
+		return false;
+
+	Cpuid(regs, 1);
+	const bool fma = (regs[2] & (1 << 12)) != 0;
+	const bool osxsave = (regs[2] & (1 << 27)) != 0;
+	const bool avx = (regs[2] & (1 << 28)) != 0;
+	if (!fma || !osxsave || !avx)
+		return false;
+	if ((Xgetbv0() & 0x6) != 0x6)
+		return false;
+
+	Cpuid(regs, 7);
+	return (regs[1] & (1 << 5)) != 0;
+}
+
+#endif
+
+//|___________________
+//|
+//| Dispatch
+//|___________________
+
+static const BatchKernels* kernels = NULL;
+static BatchIsa current_isa = BATCH_SCALAR;
+
+static const BatchKernels& Kernels()
+{
+	if (!kernels)
+		SetBatchIsa(DetectBatchIsa());
+	return *kernels;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: IsBatchIsaSupported
+//|
+//! \param isa   [in] Kernel set.
+//! \return True if this CPU (and this build) can run it.
+//|____________________________________________________________________
+
+bool IsBatchIsaSupported(BatchIsa isa)
+{
+	switch (isa) {
+	case BATCH_SCALAR:
+		return true;
+#ifdef BATCH_X86
+	case BATCH_SSE:
+		return CpuHasSSE2();
+	case BATCH_AVX2:
+		return CpuHasAVX2();
+#endif
+	default:
+		return false;
+	}
+}
+
+//|____________________________________________________________________
+//|
+//| Function: DetectBatchIsa
+//|
+//! \param None.
+//! \return Fastest kernel set this CPU can run.
+//|____________________________________________________________________
+
+BatchIsa DetectBatchIsa()
+{
+	if (IsBatchIsaSupported(BATCH_AVX2))
+		return BATCH_AVX2;
+	if (IsBatchIsaSupported(BATCH_SSE))
+		return BATCH_SSE;
+	return BATCH_SCALAR;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: SetBatchIsa
+//|
+//! \param isa   [in] Kernel set to use from now on.
+//! \return False, leaving the current set, if the CPU cannot run it.
+//|____________________________________________________________________
+
+bool SetBatchIsa(BatchIsa isa)
+{
+	if (!IsBatchIsaSupported(isa))
+		return false;
+
+	switch (isa) {
+#ifdef BATCH_X86
+	case BATCH_SSE:
+		kernels = &SSE_KERNELS;
+		break;
+	case BATCH_AVX2:
+		kernels = &AVX2_KERNELS;
+		break;
+#endif
+	default:
+		kernels = &SCALAR_KERNELS;
+		break;
+	}
+	current_isa = isa;
+	return true;
+}
+
+BatchIsa GetBatchIsa()
+{
+	Kernels();
+	return current_isa;
+}
+
+const char* BatchIsaName(BatchIsa isa)
+{
+	switch (isa) {
+	case BATCH_SCALAR: return "scalar";
+	case BATCH_SSE:    return "sse";
+	case BATCH_AVX2:   return "avx2";
+	default:           return "unknown";
+	}
+}
+
+//|___________________
+//|
+//| Batch API
+//|___________________
+
+void XformPoints(const gmtl::Matrix44f& m, const gmtl::Point3f* in, gmtl::Point3f* out, size_t count)
+{
+	Kernels().points(m.mData, reinterpret_cast<const float*>(in), reinterpret_cast<float*>(out), count);
+}
+
+void XformVectors(const gmtl::Matrix44f& m, const gmtl::Vec3f* in, gmtl::Vec3f* out, size_t count)
+{
+	Kernels().vectors(m.mData, reinterpret_cast<const float*>(in), reinterpret_cast<float*>(out), count);
+}
+
+void ComposeMatrices(const gmtl::Matrix44f* lhs, const gmtl::Matrix44f* rhs, gmtl::Matrix44f* out, size_t count)
+{
+	Kernels().compose(lhs, rhs, out, count);
+}
+
+void InvertRigid(const gmtl::Matrix44f* in, gmtl::Matrix44f* out, size_t count)
+{
+	Kernels().invert(in, out, count);
+}
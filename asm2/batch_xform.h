@@ -0,0 +1,69 @@
+//|___________________________________________________________________
+//!
+//! \file batch_xform.h
+//!
+//! \brief Batch versions of the gmtl transforms the renderer uses.
+//!
+//! Each call does what the matching gmtl call does, once per array
+//! element:
+//!   XformPoints()      out[i] = m * in[i]          (Matrix44f * Point3f)
+//!   XformVectors()     out[i] = m * in[i]          (Matrix44f * Vec3f)
+//!   ComposeMatrices()  out[i] = lhs[i] * rhs[i]    (Matrix44f * Matrix44f)
+//!   InvertRigid()      gmtl::invert(out[i], in[i]) (rotation + translation only)
+//!
+//! Points are only correct for affine matrices (bottom row 0 0 0 1),
+//! where gmtl's homogeneous divide is by 1. InvertRigid() expects a
+//! pure rotation plus translation; its inverse is then R^T and -R^T t.
+//!
+//! The kernel set (AVX2, SSE or plain C++) is picked on first use from
+//! what the CPU supports. SetBatchIsa() can force one, e.g. to compare.
+//! Output arrays may alias input arrays exactly, but not partially.
+//!
+//! Only bench/batch_xform_bench builds this for now; add it to asm2's
+//! project once the renderer has batches worth transforming.
+//|___________________________________________________________________
+
+#ifndef BATCH_XFORM_H
+#define BATCH_XFORM_H
+
+//|___________________
+//|
+//| Includes
+//|___________________
+
+#include <stddef.h>
+
+#include <gmtl/Matrix.h>
+#include <gmtl/Point.h>
+#include <gmtl/Vec.h>
+
+//|___________________
+//|
+//| Types
+//|___________________
+
+enum BatchIsa
+{
+	BATCH_SCALAR,
+	BATCH_SSE,
+	BATCH_AVX2,
+	BATCH_NUM_ISAS
+};
+
+//|___________________
+//|
+//| Function Prototypes
+//|___________________
+
+void XformPoints(const gmtl::Matrix44f& m, const gmtl::Point3f* in, gmtl::Point3f* out, size_t count);
+void XformVectors(const gmtl::Matrix44f& m, const gmtl::Vec3f* in, gmtl::Vec3f* out, size_t count);
+void ComposeMatrices(const gmtl::Matrix44f* lhs, const gmtl::Matrix44f* rhs, gmtl::Matrix44f* out, size_t count);
+void InvertRigid(const gmtl::Matrix44f* in, gmtl::Matrix44f* out, size_t count);
+
+BatchIsa DetectBatchIsa();               // best kernel set this CPU can run
+bool IsBatchIsaSupported(BatchIsa isa);
+bool SetBatchIsa(BatchIsa isa);          // false (and no change) if unsupported
+BatchIsa GetBatchIsa();
+const char* BatchIsaName(BatchIsa isa);
+
+#endif
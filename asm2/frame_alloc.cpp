@@ -0,0 +1,192 @@
+//|___________________________________________________________________
+//!
+//! \file frame_alloc.cpp
+//!
+//! \brief Allocators that keep the frame loop off the heap.
+//|___________________________________________________________________
+
+//|___________________
+//|
+//| Includes
+//|___________________
+
+#include "frame_alloc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+//|___________________
+//|
+//| Global Variables
+//|___________________
+
+static FrameAllocStats alloc_stats;
+static bool in_frame = false;
+
+//|____________________________________________________________________
+//|
+//| Function: FrameArena::FrameArena
+//|
+//! \param capacity   [in] Bytes available per frame.
+//!
+//! The only heap allocation the arena ever makes.
+//|____________________________________________________________________
+
+FrameArena::FrameArena(size_t capacity)
+	: base(static_cast<char*>(malloc(capacity))), capacity(capacity), offset(0), high_water(0)
+{
+	if (!base)
+		this->capacity = 0;
+}
+
+FrameArena::~FrameArena()
+{
+	free(base);
+}
+
+//|____________________________________________________________________
+//|
+//| Function: FrameArena::Alloc
+//|
+//! \param size    [in] Bytes wanted.
+//! \param align   [in] Alignment, a power of two.
+//! \return Pointer into the arena, or NULL if it is full.
+//|____________________________________________________________________
+
+void* FrameArena::Alloc(size_t size, size_t align)
+{
+	const size_t start = (offset + align - 1) & ~(align - 1);
+	if (start + size > capacity) {
+		assert(!"frame arena exhausted, raise its capacity");
+		return NULL;
+	}
+
+	offset = start + size;
+	if (offset > high_water)
+		high_water = offset;
+	return base + start;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: BeginFrameAllocCheck / EndFrameAllocCheck
+//|
+//! Bracket a frame. Heap allocations in between are counted, and the
+//! frame is reported when it ends if there were any.
+//|____________________________________________________________________
+
+void BeginFrameAllocCheck()
+{
+	alloc_stats.last_allocs = 0;
+	alloc_stats.last_bytes = 0;
+	in_frame = true;
+}
+
+void EndFrameAllocCheck()
+{
+	in_frame = false;
+	alloc_stats.frames++;
+
+	if (alloc_stats.last_allocs > 0) {
+		alloc_stats.dirty_frames++;
+		fprintf(stderr, "frame %lld: %d heap allocation(s), %zu bytes\n",
+			alloc_stats.frames, alloc_stats.last_allocs, alloc_stats.last_bytes);
+	}
+}
+
+const FrameAllocStats& GetFrameAllocStats()
+{
+	return alloc_stats;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: FrameAllocCheckEnabled
+//|
+//! \return True if this build hooks operator new.
+//|____________________________________________________________________
+
+bool FrameAllocCheckEnabled()
+{
+#ifdef FRAME_ALLOC_CHECK
+	return true;
+#else
+	return false;
+#endif
+}
+
+//|___________________
+//|
+//| operator new hook
+//|___________________
+
+#ifdef FRAME_ALLOC_CHECK
+
+static void* CheckedAlloc(size_t size)
+{
+	if (in_frame) {
+		alloc_stats.last_allocs++;
+		alloc_stats.last_bytes += size;
+		alloc_stats.allocs++;
+		alloc_stats.bytes += size;
+	}
+	return malloc(size ? size : 1);
+}
+
+void* operator new(size_t size)
+{
+	void* p = CheckedAlloc(size);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	void* p = CheckedAlloc(size);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return CheckedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return CheckedAlloc(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	free(p);
+}
+
+#endif
@@ -0,0 +1,154 @@
+//|___________________________________________________________________
+//!
+//! \file frame_alloc.h
+//!
+//! \brief Allocators that keep the frame loop off the heap.
+//!
+//! FrameArena hands out scratch memory that only lives until the end of
+//! the current frame; DisplayFunc() resets it at the start of every
+//! frame. ObjectPool holds long-lived scene objects in a fixed block.
+//!
+//! When FRAME_ALLOC_CHECK is defined (Debug builds), operator new is
+//! hooked and any heap allocation made between BeginFrameAllocCheck()
+//! and EndFrameAllocCheck() is counted and reported on the console.
+//|___________________________________________________________________
+
+#ifndef FRAME_ALLOC_H
+#define FRAME_ALLOC_H
+
+//|___________________
+//|
+//| Includes
+//|___________________
+
+#include <assert.h>
+#include <stddef.h>
+
+#include <new>
+
+//|___________________
+//|
+//| Types
+//|___________________
+
+// Heap use seen by the operator new hook
+struct FrameAllocStats
+{
+	long long frames;              // frames checked
+	long long dirty_frames;        // frames that allocated at least once
+	long long allocs;              // allocations inside frames, all time
+	size_t bytes;                  // bytes allocated inside frames, all time
+	int last_allocs;               // allocations in the last frame
+	size_t last_bytes;             // bytes allocated in the last frame
+};
+
+//|___________________
+//|
+//| Class: FrameArena
+//|___________________
+
+class FrameArena
+{
+public:
+	explicit FrameArena(size_t capacity);
+	~FrameArena();
+
+	// Returns uninitialized memory valid until the next Reset(), or NULL
+	// (and asserts) if the arena is full
+	void* Alloc(size_t size, size_t align);
+
+	// Array of count default-constructed T; T must be trivially destructible
+	template <typename T>
+	T* Alloc(size_t count)
+	{
+		T* p = static_cast<T*>(Alloc(count * sizeof(T), alignof(T)));
+		for (size_t i = 0; p && i < count; i++)
+			new (p + i) T();
+		return p;
+	}
+
+	void Reset() { offset = 0; }
+
+	size_t Capacity() const { return capacity; }
+	size_t Used() const { return offset; }
+	size_t HighWater() const { return high_water; }
+
+private:
+	FrameArena(const FrameArena&);
+	FrameArena& operator=(const FrameArena&);
+
+	char* base;
+	size_t capacity;
+	size_t offset;
+	size_t high_water;
+};
+
+//|___________________
+//|
+//| Class: ObjectPool
+//|___________________
+
+// Fixed number of T slots with a free list threaded through the unused
+// ones. Create()/Destroy() never touch the heap.
+template <typename T, int N>
+class ObjectPool
+{
+public:
+	ObjectPool() : free_list(NULL), live(0)
+	{
+		for (int i = N - 1; i >= 0; i--) {
+			slots[i].next = free_list;
+			free_list = &slots[i];
+		}
+	}
+
+	~ObjectPool() { assert(live == 0 && "objects still alive in pool"); }
+
+	// Returns NULL when the pool is full
+	T* Create()
+	{
+		if (!free_list)
+			return NULL;
+		Slot* slot = free_list;
+		free_list = slot->next;
+		live++;
+		return new (slot) T();
+	}
+
+	void Destroy(T* obj)
+	{
+		if (!obj)
+			return;
+		obj->~T();
+		Slot* slot = reinterpret_cast<Slot*>(obj);
+		slot->next = free_list;
+		free_list = slot;
+		live--;
+	}
+
+	int Live() const { return live; }
+	int Capacity() const { return N; }
+
+private:
+	union Slot
+	{
+		Slot* next;
+		alignas(T) unsigned char storage[sizeof(T)];
+	};
+
+	Slot slots[N];
+	Slot* free_list;
+	int live;
+};
+
+//|___________________
+//|
+//| Function Prototypes
+//|___________________
+
+void BeginFrameAllocCheck();
+void EndFrameAllocCheck();
+const FrameAllocStats& GetFrameAllocStats();
+bool FrameAllocCheckEnabled();
+
+#endif
@@ -0,0 +1,181 @@
+//|___________________________________________________________________
+//!
+//! \file gl_procs.cpp
+//!
+//! \brief Runtime loading of the post-1.1 OpenGL entry points.
+//|___________________________________________________________________
+
+//|___________________
+//|
+//| Includes
+//|___________________
+
+#include "gl_procs.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+#include <GL/freeglut_ext.h>    // glutGetProcAddress()
+
+//|___________________
+//|
+//| Constants
+//|___________________
+
+// How long to block per glClientWaitSync() call in WaitForFence() (nanoseconds)
+const unsigned long long FENCE_WAIT_TIMEOUT = 1000000000ull;
+
+//|___________________
+//|
+//| Global Variables
+//|___________________
+
+GlGenBuffersProc     glprocGenBuffers = NULL;
+GlDeleteBuffersProc  glprocDeleteBuffers = NULL;
+GlBindBufferProc     glprocBindBuffer = NULL;
+GlUnmapBufferProc    glprocUnmapBuffer = NULL;
+GlBufferStorageProc  glprocBufferStorage = NULL;
+GlMapBufferRangeProc glprocMapBufferRange = NULL;
+GlFenceSyncProc      glprocFenceSync = NULL;
+GlClientWaitSyncProc glprocClientWaitSync = NULL;
+GlDeleteSyncProc     glprocDeleteSync = NULL;
+
+// Features the driver reports, filled by LoadGLProcs()
+static bool has_buffer_storage = false;
+static bool has_fence_sync = false;
+
+//|____________________________________________________________________
+//|
+//| Function: HasGLFeature
+//|
+//! \param major       [in] Core version that introduced the feature.
+//! \param minor       [in] Core version that introduced the feature.
+//! \param extension   [in] Name of the equivalent ARB extension.
+//! \return True if the current context provides the feature.
+//!
+//! Checks the context version first, then the extension string.
+//|____________________________________________________________________
+
+static bool HasGLFeature(int major, int minor, const char* extension)
+{
+	// GL_VERSION starts with "<major>.<minor>"
+	const char* version = (const char*)glGetString(GL_VERSION);
+	if (version) {
+		char* end = NULL;
+		const long ctx_major = strtol(version, &end, 10);
+		const long ctx_minor = (*end == '.') ? strtol(end + 1, NULL, 10) : 0;
+		if (ctx_major > major || (ctx_major == major && ctx_minor >= minor))
+			return true;
+	}
+
+	// Compatibility contexts still answer GL_EXTENSIONS with one long string;
+	// match whole names only so "GL_ARB_sync" does not match "GL_ARB_syncX"
+	const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+	if (!extensions)
+		return false;
+
+	const size_t len = strlen(extension);
+	for (const char* p = strstr(extensions, extension); p; p = strstr(p + len, extension)) {
+		const bool starts = (p == extensions || p[-1] == ' ');
+		const bool ends = (p[len] == ' ' || p[len] == '\0');
+		if (starts && ends)
+			return true;
+	}
+	return false;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: LoadGLProcs
+//|
+//! \param None.
+//! \return None.
+//!
+//! Fetches the entry points from the driver. Needs a current context,
+//! so call it after glutCreateWindow().
+//|____________________________________________________________________
+
+void LoadGLProcs()
+{
+	glprocGenBuffers = (GlGenBuffersProc)glutGetProcAddress("glGenBuffers");
+	glprocDeleteBuffers = (GlDeleteBuffersProc)glutGetProcAddress("glDeleteBuffers");
+	glprocBindBuffer = (GlBindBufferProc)glutGetProcAddress("glBindBuffer");
+	glprocUnmapBuffer = (GlUnmapBufferProc)glutGetProcAddress("glUnmapBuffer");
+	glprocBufferStorage = (GlBufferStorageProc)glutGetProcAddress("glBufferStorage");
+	glprocMapBufferRange = (GlMapBufferRangeProc)glutGetProcAddress("glMapBufferRange");
+	glprocFenceSync = (GlFenceSyncProc)glutGetProcAddress("glFenceSync");
+	glprocClientWaitSync = (GlClientWaitSyncProc)glutGetProcAddress("glClientWaitSync");
+	glprocDeleteSync = (GlDeleteSyncProc)glutGetProcAddress("glDeleteSync");
+
+	// wglGetProcAddress can hand back non-NULL stubs for unsupported calls,
+	// so the version/extension check decides, not the pointers alone
+	has_fence_sync = HasGLFeature(3, 2, "GL_ARB_sync")
+		&& glprocFenceSync && glprocClientWaitSync && glprocDeleteSync;
+
+	has_buffer_storage = HasGLFeature(4, 4, "GL_ARB_buffer_storage")
+		&& glprocGenBuffers && glprocDeleteBuffers && glprocBindBuffer && glprocUnmapBuffer
+		&& glprocBufferStorage && glprocMapBufferRange
+		&& has_fence_sync;                          // persistent mappings need fences to be safe
+}
+
+//|____________________________________________________________________
+//|
+//| Function: HasBufferStorage
+//|
+//! \param None.
+//! \return True if persistently mapped buffers can be used.
+//|____________________________________________________________________
+
+bool HasBufferStorage()
+{
+	return has_buffer_storage;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: HasFenceSync
+//|
+//! \param None.
+//! \return True if fence sync objects can be used.
+//|____________________________________________________________________
+
+bool HasFenceSync()
+{
+	return has_fence_sync;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: WaitForFence
+//|
+//! \param fence   [in] Fence to wait on.
+//! \return GL_ALREADY_SIGNALED or GL_CONDITION_SATISFIED once the fence
+//!         has signalled, GL_WAIT_FAILED if it never will.
+//!
+//! Flushes on the first wait so the fence is sure to reach the GPU. The
+//! caller still owns the fence and deletes it.
+//|____________________________________________________________________
+
+GLenum WaitForFence(GlSyncHandle fence)
+{
+	GLenum result;
+	do {
+		result = glprocClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_WAIT_TIMEOUT);
+	} while (result == GL_TIMEOUT_EXPIRED);
+	return result;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: NowMs
+//|
+//! \return Monotonic time in milliseconds.
+//|____________________________________________________________________
+
+double NowMs()
+{
+	using namespace std::chrono;
+	return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,118 @@
+//|___________________________________________________________________
+//!
+//! \file gl_procs.h
+//!
+//! \brief Post-1.1 OpenGL entry points loaded at runtime.
+//!
+//! The Windows OpenGL headers stop at version 1.1, so anything newer
+//! (buffer objects, buffer storage, fence syncs) has to be fetched from the
+//! driver once a context exists. The pointers stay NULL when the driver
+//! does not expose the feature; check the Has* flags before using them.
+//!
+//! Also home to the helpers shared by everything that fences frames:
+//! a blocking fence wait and the millisecond clock the timings use.
+//|___________________________________________________________________
+
+#ifndef GL_PROCS_H
+#define GL_PROCS_H
+
+//|___________________
+//|
+//| Includes
+//|___________________
+
+#include <stddef.h>
+
+#include <GL/glut.h>
+
+//|___________________
+//|
+//| Constants
+//|___________________
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER                0x8892
+#endif
+#ifndef GL_MAP_WRITE_BIT
+#define GL_MAP_WRITE_BIT               0x0002
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT          0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT            0x0080
+#endif
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE  0x9117
+#endif
+#ifndef GL_SYNC_FLUSH_COMMANDS_BIT
+#define GL_SYNC_FLUSH_COMMANDS_BIT     0x00000001
+#endif
+#ifndef GL_ALREADY_SIGNALED
+#define GL_ALREADY_SIGNALED            0x911A
+#endif
+#ifndef GL_TIMEOUT_EXPIRED
+#define GL_TIMEOUT_EXPIRED             0x911B
+#endif
+#ifndef GL_CONDITION_SATISFIED
+#define GL_CONDITION_SATISFIED         0x911C
+#endif
+#ifndef GL_WAIT_FAILED
+#define GL_WAIT_FAILED                 0x911D
+#endif
+
+//|___________________
+//|
+//| Types
+//|___________________
+
+// Sync objects are opaque driver handles (GLsync in newer headers)
+typedef void* GlSyncHandle;
+
+// Buffer objects (GL 1.5)
+typedef void (APIENTRY* GlGenBuffersProc)(GLsizei n, GLuint* buffers);
+typedef void (APIENTRY* GlDeleteBuffersProc)(GLsizei n, const GLuint* buffers);
+typedef void (APIENTRY* GlBindBufferProc)(GLenum target, GLuint buffer);
+typedef GLboolean (APIENTRY* GlUnmapBufferProc)(GLenum target);
+
+// Immutable storage and range mapping (GL 4.4 / ARB_buffer_storage, GL 3.0)
+typedef void (APIENTRY* GlBufferStorageProc)(GLenum target, ptrdiff_t size, const void* data, GLbitfield flags);
+typedef void* (APIENTRY* GlMapBufferRangeProc)(GLenum target, ptrdiff_t offset, ptrdiff_t length, GLbitfield access);
+
+// Fence syncs (GL 3.2 / ARB_sync)
+typedef GlSyncHandle (APIENTRY* GlFenceSyncProc)(GLenum condition, GLbitfield flags);
+typedef GLenum (APIENTRY* GlClientWaitSyncProc)(GlSyncHandle sync, GLbitfield flags, unsigned long long timeout);
+typedef void (APIENTRY* GlDeleteSyncProc)(GlSyncHandle sync);
+
+//|___________________
+//|
+//| Global Variables
+//|___________________
+
+extern GlGenBuffersProc     glprocGenBuffers;
+extern GlDeleteBuffersProc  glprocDeleteBuffers;
+extern GlBindBufferProc     glprocBindBuffer;
+extern GlUnmapBufferProc    glprocUnmapBuffer;
+extern GlBufferStorageProc  glprocBufferStorage;
+extern GlMapBufferRangeProc glprocMapBufferRange;
+extern GlFenceSyncProc      glprocFenceSync;
+extern GlClientWaitSyncProc glprocClientWaitSync;
+extern GlDeleteSyncProc     glprocDeleteSync;
+
+//|___________________
+//|
+//| Function Prototypes
+//|___________________
+
+void LoadGLProcs();
+bool HasBufferStorage();
+bool HasFenceSync();
+
+GLenum WaitForFence(GlSyncHandle fence);   // blocks until signalled or failed; does not delete it
+double NowMs();                            // monotonic clock in milliseconds
+
+#endif
@@ -0,0 +1,261 @@
+//|___________________________________________________________________
+//!
+//! \file latency.cpp
+//!
+//! \brief Input-to-photon latency measurement.
+//|___________________________________________________________________
+
+//|___________________
+//|
+//| Includes
+//|___________________
+
+#include "latency.h"
+
+#include <math.h>
+
+//|____________________________________________________________________
+//|
+//| Function: LatencyHistogram::LatencyHistogram
+//|____________________________________________________________________
+
+LatencyHistogram::LatencyHistogram()
+{
+	Reset();
+}
+
+//|____________________________________________________________________
+//|
+//| Function: LatencyHistogram::Add
+//|
+//! \param ms   [in] One latency sample in milliseconds.
+//! \return None.
+//|____________________________________________________________________
+
+void LatencyHistogram::Add(double ms)
+{
+	if (ms < 0.0)
+		ms = 0.0;
+
+	int bin = (int)(ms / LAT_BIN_MS);
+	if (bin > LAT_NUM_BINS)
+		bin = LAT_NUM_BINS;
+	bins[bin]++;
+
+	if (count == 0 || ms < min_ms)
+		min_ms = ms;
+	if (count == 0 || ms > max_ms)
+		max_ms = ms;
+	sum_ms += ms;
+	count++;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: LatencyHistogram::Reset
+//|____________________________________________________________________
+
+void LatencyHistogram::Reset()
+{
+	for (int i = 0; i <= LAT_NUM_BINS; i++)
+		bins[i] = 0;
+	count = 0;
+	sum_ms = 0.0;
+	min_ms = 0.0;
+	max_ms = 0.0;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: LatencyHistogram::Percentile
+//|
+//! \param fraction   [in] 0.5 for p50, 0.95 for p95, ...
+//! \return Latency in ms, accurate to one bin width.
+//|____________________________________________________________________
+
+double LatencyHistogram::Percentile(double fraction) const
+{
+	if (count == 0)
+		return 0.0;
+
+	long long target = (long long)ceil(fraction * count);
+	if (target < 1)
+		target = 1;
+
+	long long seen = 0;
+	for (int i = 0; i < LAT_NUM_BINS; i++) {
+		seen += bins[i];
+		if (seen >= target)
+			return (i + 1) * LAT_BIN_MS;
+	}
+	return max_ms;                          // falls in the overflow bin
+}
+
+//|____________________________________________________________________
+//|
+//| Function: LatencyHistogram::WriteCSV
+//|
+//! \param file   [in] Open file to write to.
+//! \return None.
+//|____________________________________________________________________
+
+void LatencyHistogram::WriteCSV(FILE* file) const
+{
+	fprintf(file, "bin_start_ms,bin_end_ms,count\n");
+	for (int i = 0; i < LAT_NUM_BINS; i++) {
+		if (bins[i])
+			fprintf(file, "%.1f,%.1f,%lld\n", i * LAT_BIN_MS, (i + 1) * LAT_BIN_MS, bins[i]);
+	}
+	if (bins[LAT_NUM_BINS])
+		fprintf(file, "%.1f,inf,%lld\n", LAT_NUM_BINS * LAT_BIN_MS, bins[LAT_NUM_BINS]);
+}
+
+//|____________________________________________________________________
+//|
+//| Function: LatencyTracker::LatencyTracker
+//|____________________________________________________________________
+
+LatencyTracker::LatencyTracker()
+	: num_pending(0), first_in_flight(0), num_in_flight(0), dropped(0)
+{
+	current.fence = NULL;
+	current.num_stamps = 0;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: LatencyTracker::OnInput
+//|____________________________________________________________________
+
+void LatencyTracker::OnInput()
+{
+	if (num_pending < LAT_MAX_STAMPS)
+		pending[num_pending++] = NowMs();
+	else
+		dropped++;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: LatencyTracker::BeginFrame
+//|____________________________________________________________________
+
+void LatencyTracker::BeginFrame()
+{
+	for (int i = 0; i < num_pending; i++)
+		current.stamps[i] = pending[i];
+	current.num_stamps = num_pending;
+	current.fence = NULL;
+	num_pending = 0;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: LatencyTracker::EndFrame
+//|
+//! \param None.
+//! \return None.
+//!
+//! Records input-to-submit right away, then queues a fence for
+//! input-to-complete. Frames that carry no input are not fenced.
+//|____________________________________________________________________
+
+void LatencyTracker::EndFrame()
+{
+	if (current.num_stamps == 0)
+		return;
+
+	const double now = NowMs();
+	for (int i = 0; i < current.num_stamps; i++)
+		to_submit.Add(now - current.stamps[i]);
+
+	if (!HasFenceSync()) {
+		current.num_stamps = 0;
+		return;
+	}
+
+	// Ring full: wait for the oldest frame rather than lose its samples
+	if (num_in_flight == LAT_MAX_IN_FLIGHT) {
+		Frame& oldest = in_flight[first_in_flight];
+		if (WaitForFence(oldest.fence) == GL_WAIT_FAILED) {
+			glprocDeleteSync(oldest.fence);     // fence is unusable, drop its samples
+			dropped += oldest.num_stamps;
+		}
+		else {
+			Complete(oldest, NowMs());
+		}
+		first_in_flight = (first_in_flight + 1) % LAT_MAX_IN_FLIGHT;
+		num_in_flight--;
+	}
+
+	current.fence = glprocFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush();                              // make sure the fence itself reaches the GPU
+
+	in_flight[(first_in_flight + num_in_flight) % LAT_MAX_IN_FLIGHT] = current;
+	num_in_flight++;
+	current.num_stamps = 0;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: LatencyTracker::Poll
+//|
+//! \param None.
+//! \return None.
+//!
+//! Frames complete in order, so this stops at the first unsignalled one.
+//|____________________________________________________________________
+
+void LatencyTracker::Poll()
+{
+	while (num_in_flight > 0) {
+		Frame& oldest = in_flight[first_in_flight];
+		const GLenum result = glprocClientWaitSync(oldest.fence, 0, 0);
+
+		if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) {
+			Complete(oldest, NowMs());
+		}
+		else if (result == GL_WAIT_FAILED) {
+			glprocDeleteSync(oldest.fence);     // fence is unusable, drop its samples
+			dropped += oldest.num_stamps;
+		}
+		else {
+			break;
+		}
+
+		first_in_flight = (first_in_flight + 1) % LAT_MAX_IN_FLIGHT;
+		num_in_flight--;
+	}
+}
+
+//|____________________________________________________________________
+//|
+//| Function: LatencyTracker::Reset
+//|
+//! Clears the histograms; frames still in flight will land in the new ones.
+//|____________________________________________________________________
+
+void LatencyTracker::Reset()
+{
+	to_submit.Reset();
+	to_complete.Reset();
+	dropped = 0;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: LatencyTracker::Complete
+//|
+//! \param frame   [in] Frame whose fence has signalled.
+//! \param now     [in] Time the signal was seen.
+//! \return None.
+//|____________________________________________________________________
+
+void LatencyTracker::Complete(Frame& frame, double now)
+{
+	for (int i = 0; i < frame.num_stamps; i++)
+		to_complete.Add(now - frame.stamps[i]);
+
+	glprocDeleteSync(frame.fence);
+	frame.fence = NULL;
+}
@@ -0,0 +1,130 @@
+//|___________________________________________________________________
+//!
+//! \file latency.h
+//!
+//! \brief Input-to-photon latency measurement.
+//!
+//! Every keyboard event that moves something is stamped on arrival.
+//! The next frame picks up the stamps, since it is the first one to
+//! show the updated poses. After the frame is presented, a fence goes
+//! in behind it. When the fence signals (the GPU has finished the
+//! frame, including the swap), the time since each stamp goes into a
+//! histogram. Scan-out after that point is not measured.
+//!
+//! All storage is fixed-size so tracking does not allocate per frame.
+//|___________________________________________________________________
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+//|___________________
+//|
+//| Includes
+//|___________________
+
+#include <stdio.h>
+
+#include "gl_procs.h"
+
+//|___________________
+//|
+//| Constants
+//|___________________
+
+const int LAT_NUM_BINS = 1000;            // histogram bins
+const double LAT_BIN_MS = 0.1;            // bin width, so bins cover 0 - 100 ms
+const int LAT_MAX_STAMPS = 32;            // input events carried by one frame
+const int LAT_MAX_IN_FLIGHT = 8;          // presented frames awaiting their fence
+
+//|___________________
+//|
+//| Class: LatencyHistogram
+//|___________________
+
+class LatencyHistogram
+{
+public:
+	LatencyHistogram();
+
+	void Add(double ms);
+	void Reset();
+
+	// Upper edge of the bin holding the given fraction (0.5 = median)
+	double Percentile(double fraction) const;
+
+	long long Count() const { return count; }
+	double Min() const { return count ? min_ms : 0.0; }
+	double Max() const { return count ? max_ms : 0.0; }
+	double Mean() const { return count ? sum_ms / count : 0.0; }
+
+	// Writes "bin_start_ms,bin_end_ms,count" lines for the non-empty bins
+	void WriteCSV(FILE* file) const;
+
+private:
+	long long bins[LAT_NUM_BINS + 1];     // last bin collects everything >= 100 ms
+	long long count;
+	double sum_ms;
+	double min_ms;
+	double max_ms;
+};
+
+//|___________________
+//|
+//| Class: LatencyTracker
+//|___________________
+
+class LatencyTracker
+{
+public:
+	LatencyTracker();
+
+	// Stamps an input event (call first thing in the input callback, and
+	// only for events that change what is drawn)
+	void OnInput();
+
+	// The frame about to be drawn takes over the pending stamps
+	void BeginFrame();
+
+	// Call right after glFlush()/glutSwapBuffers(): fences the frame
+	void EndFrame();
+
+	// Collects frames whose fences have signalled. Never blocks.
+	void Poll();
+
+	// True while presented frames are still waiting on their fence
+	bool Pending() const { return num_in_flight > 0; }
+
+	void Reset();
+
+	// True if completion comes from fences; false means the times stop at
+	// submission because the driver has no sync objects
+	bool UsesFences() const { return HasFenceSync(); }
+
+	const LatencyHistogram& InputToSubmit() const { return to_submit; }
+	const LatencyHistogram& InputToComplete() const { return to_complete; }
+	long long Dropped() const { return dropped; }
+
+private:
+	struct Frame
+	{
+		GlSyncHandle fence;
+		double stamps[LAT_MAX_STAMPS];
+		int num_stamps;
+	};
+
+	void Complete(Frame& frame, double now);
+
+	double pending[LAT_MAX_STAMPS];       // inputs not yet picked up by a frame
+	int num_pending;
+
+	Frame current;                        // frame being drawn
+	Frame in_flight[LAT_MAX_IN_FLIGHT];   // ring, oldest at first_in_flight
+	int first_in_flight;
+	int num_in_flight;
+
+	LatencyHistogram to_submit;
+	LatencyHistogram to_complete;
+	long long dropped;                    // stamps lost because a frame was full
+};
+
+#endif
@@ -0,0 +1,404 @@
+//|___________________________________________________________________
+//!
+//! \file occlusion.cpp
+//!
+//! \brief Hierarchical-Z occlusion culling done on the CPU.
+//|___________________________________________________________________
+
+//|___________________
+//|
+//| Includes
+//|___________________
+
+#include "occlusion.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "gl_procs.h"       // NowMs()
+
+//|___________________
+//|
+//| Constants
+//|___________________
+
+// Far depth (window coordinates, as with glDepthRange(0, 1))
+const float OCC_FAR_DEPTH = 1.0f;
+
+// A box must be this much farther than the pyramid to count as hidden
+const float OCC_DEPTH_BIAS = 1e-6f;
+
+// Texels a tested rectangle may span at the chosen pyramid level. Coarser
+// levels are cheaper to read but blur the occluders' edges outwards.
+const int OCC_TEST_SPAN = 4;
+
+// The 6 faces of a box, corners in order around each face, numbered x | y << 1 | z << 2
+const int BOX_FACES[6][4] = {
+	{ 0, 2, 6, 4 },   // -X
+	{ 1, 3, 7, 5 },   // +X
+	{ 0, 1, 5, 4 },   // -Y
+	{ 2, 3, 7, 6 },   // +Y
+	{ 0, 1, 3, 2 },   // -Z
+	{ 4, 5, 7, 6 },   // +Z
+};
+
+// Depth marking a texel corner that no face of the box covers; beyond OCC_FAR_DEPTH
+const float OCC_UNCOVERED = 2.0f;
+
+//|____________________________________________________________________
+//|
+//| Function: ProjectBoxCorners
+//|
+//! \param m         [in]  Clip-from-object matrix (column-major).
+//! \param box_min   [in]  Box minimum corner.
+//! \param box_max   [in]  Box maximum corner.
+//! \param screen    [out] Corners in depth buffer texels (x, y) and window depth (z).
+//! \return False if a corner is in front of the near plane (cannot be projected safely).
+//|____________________________________________________________________
+
+static bool ProjectBoxCorners(const float m[16], const float box_min[3], const float box_max[3], float screen[8][3])
+{
+	for (int i = 0; i < 8; i++) {
+		const float x = (i & 1) ? box_max[0] : box_min[0];
+		const float y = (i & 2) ? box_max[1] : box_min[1];
+		const float z = (i & 4) ? box_max[2] : box_min[2];
+
+		const float cx = m[0] * x + m[4] * y + m[8] * z + m[12];
+		const float cy = m[1] * x + m[5] * y + m[9] * z + m[13];
+		const float cz = m[2] * x + m[6] * y + m[10] * z + m[14];
+		const float cw = m[3] * x + m[7] * y + m[11] * z + m[15];
+
+		if (cw <= 0.0f || cz < -cw)
+			return false;
+
+		const float inv_w = 1.0f / cw;
+		screen[i][0] = (cx * inv_w * 0.5f + 0.5f) * OCC_SIZE;
+		screen[i][1] = (cy * inv_w * 0.5f + 0.5f) * OCC_SIZE;
+		screen[i][2] = cz * inv_w * 0.5f + 0.5f;
+	}
+	return true;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: OcclusionCuller::OcclusionCuller
+//|____________________________________________________________________
+
+OcclusionCuller::OcclusionCuller()
+	: num_levels(0), num_candidates(0), rasterized_owner(OCC_NO_OWNER), single_owner(true),
+	frame_start_ms(0.0)
+{
+	// Lay out every level of the pyramid in one block, allocated once
+	int size = OCC_SIZE;
+	int offset = 0;
+	while (size >= 1) {
+		level_offsets[num_levels++] = offset;
+		offset += size * size;
+		size /= 2;
+	}
+	pyramid.assign(offset, OCC_FAR_DEPTH);
+
+	stats = OcclusionStats();
+}
+
+//|____________________________________________________________________
+//|
+//| Function: OcclusionCuller::BeginFrame
+//|
+//! \param None.
+//! \return None.
+//|____________________________________________________________________
+
+void OcclusionCuller::BeginFrame()
+{
+	std::fill(pyramid.begin(), pyramid.begin() + OCC_SIZE * OCC_SIZE, OCC_FAR_DEPTH);
+	num_candidates = 0;
+
+	stats.occluders = 0;
+	stats.tested = 0;
+	stats.culled = 0;
+	stats.cull_ms = 0.0;
+
+	frame_start_ms = NowMs();
+}
+
+//|____________________________________________________________________
+//|
+//| Function: OcclusionCuller::AddOccluder
+//|
+//! \param owner              [in] Object the occluder belongs to.
+//! \param clip_from_object   [in] P * V * M of the occluder.
+//! \param box_min            [in] Occluder box minimum corner (object space).
+//! \param box_max            [in] Occluder box maximum corner (object space).
+//! \return None.
+//|____________________________________________________________________
+
+void OcclusionCuller::AddOccluder(int owner, const float clip_from_object[16], const float box_min[3], const float box_max[3])
+{
+	if (num_candidates >= OCC_MAX_CANDIDATES)
+		return;
+
+	Occluder& occ = candidates[num_candidates++];
+	std::copy(clip_from_object, clip_from_object + 16, occ.clip_from_object);
+	std::copy(box_min, box_min + 3, occ.box_min);
+	std::copy(box_max, box_max + 3, occ.box_max);
+	occ.owner = owner;
+
+	// Clip w of the centre is its distance along the view direction
+	const float* m = clip_from_object;
+	const float x = 0.5f * (box_min[0] + box_max[0]);
+	const float y = 0.5f * (box_min[1] + box_max[1]);
+	const float z = 0.5f * (box_min[2] + box_max[2]);
+	occ.distance = m[3] * x + m[7] * y + m[11] * z + m[15];
+}
+
+//|____________________________________________________________________
+//|
+//| Function: OcclusionCuller::BuildPyramid
+//|
+//! \param None.
+//! \return None.
+//!
+//! Rasterizes the nearest occluders into level 0, then builds each
+//! coarser level from the farthest of its 4 children.
+//|____________________________________________________________________
+
+void OcclusionCuller::BuildPyramid()
+{
+	// Nearest first; occluders behind the camera have distance <= 0 and are dropped
+	int order[OCC_MAX_CANDIDATES];
+	for (int i = 0; i < num_candidates; i++)
+		order[i] = i;
+	std::sort(order, order + num_candidates,
+		[this](int a, int b) { return candidates[a].distance < candidates[b].distance; });
+
+	rasterized_owner = OCC_NO_OWNER;
+	single_owner = true;
+	for (int i = 0; i < num_candidates && stats.occluders < OCC_MAX_OCCLUDERS; i++) {
+		const Occluder& occ = candidates[order[i]];
+		if (occ.distance <= 0.0f)
+			continue;
+		RasterizeBox(occ);
+
+		if (stats.occluders == 0)
+			rasterized_owner = occ.owner;
+		else if (occ.owner != rasterized_owner)
+			single_owner = false;
+		stats.occluders++;
+	}
+
+	for (int level = 1; level < num_levels; level++) {
+		const int size = OCC_SIZE >> level;
+		const float* src = Level(level - 1);
+		float* dst = Level(level);
+
+		for (int y = 0; y < size; y++) {
+			const float* row0 = src + (2 * y) * (2 * size);
+			const float* row1 = row0 + 2 * size;
+			for (int x = 0; x < size; x++) {
+				const float a = std::max(row0[2 * x], row0[2 * x + 1]);
+				const float b = std::max(row1[2 * x], row1[2 * x + 1]);
+				dst[y * size + x] = std::max(a, b);
+			}
+		}
+	}
+}
+
+//|____________________________________________________________________
+//|
+//| Function: OcclusionCuller::IsVisible
+//|
+//! \param owner              [in] Owner the object's own occluders were added with.
+//! \param clip_from_object   [in] P * V * M of the object.
+//! \param box_min            [in] Bounding box minimum corner (object space).
+//! \param box_max            [in] Bounding box maximum corner (object space).
+//! \return False only if the whole box is behind the occluders.
+//!
+//! An object's own occluders lie inside its box and can never hide it,
+//! so when every rasterized occluder is the object's own (or there are
+//! none) the test is skipped and not counted.
+//!
+//! Otherwise picks the finest pyramid level where the box's screen
+//! rectangle spans at most OCC_TEST_SPAN texels, then compares the box's
+//! nearest depth against the farthest depth stored over that rectangle.
+//|____________________________________________________________________
+
+bool OcclusionCuller::IsVisible(int owner, const float clip_from_object[16], const float box_min[3], const float box_max[3])
+{
+	if (stats.occluders == 0 || (single_owner && owner != OCC_NO_OWNER && owner == rasterized_owner))
+		return true;
+
+	stats.tested++;
+
+	bool visible = true;
+	float screen[8][3];
+
+	if (ProjectBoxCorners(clip_from_object, box_min, box_max, screen)) {
+		float min_x = screen[0][0], max_x = screen[0][0];
+		float min_y = screen[0][1], max_y = screen[0][1];
+		float min_z = screen[0][2];
+		for (int i = 1; i < 8; i++) {
+			min_x = std::min(min_x, screen[i][0]);
+			max_x = std::max(max_x, screen[i][0]);
+			min_y = std::min(min_y, screen[i][1]);
+			max_y = std::max(max_y, screen[i][1]);
+			min_z = std::min(min_z, screen[i][2]);
+		}
+
+		// Off-screen boxes are left to OpenGL's clipping
+		const bool on_screen = max_x >= 0.0f && min_x < OCC_SIZE && max_y >= 0.0f && min_y < OCC_SIZE;
+		if (on_screen) {
+			const int x0 = std::max(0, (int)floorf(min_x));
+			const int x1 = std::min(OCC_SIZE - 1, (int)floorf(max_x));
+			const int y0 = std::max(0, (int)floorf(min_y));
+			const int y1 = std::min(OCC_SIZE - 1, (int)floorf(max_y));
+
+			int level = 0;
+			while (level < num_levels - 1 && ((std::max(x1 - x0, y1 - y0) >> level) > OCC_TEST_SPAN))
+				level++;
+
+			const int size = OCC_SIZE >> level;
+			const float* depth = Level(level);
+			float max_depth = 0.0f;
+			for (int y = y0 >> level; y <= (y1 >> level); y++)
+				for (int x = x0 >> level; x <= (x1 >> level); x++)
+					max_depth = std::max(max_depth, depth[y * size + x]);
+
+			visible = !(min_z > max_depth + OCC_DEPTH_BIAS);
+		}
+	}
+
+	if (!visible)
+		stats.culled++;
+	return visible;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: OcclusionCuller::EndFrame
+//|
+//! \param None.
+//! \return None.
+//!
+//! cull_ms covers everything since BeginFrame(), including the caller's
+//! own work in between (building the matrices, picking occluders).
+//|____________________________________________________________________
+
+void OcclusionCuller::EndFrame()
+{
+	stats.cull_ms = NowMs() - frame_start_ms;
+
+	stats.total_tested += stats.tested;
+	stats.total_culled += stats.culled;
+	stats.total_cull_ms += stats.cull_ms;
+	stats.frames++;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: OcclusionCuller::RasterizeBox
+//|
+//! \param occ   [in] Occluder to draw into level 0.
+//! \return None.
+//!
+//! Conservative: a texel is only written if the box covers all of it,
+//! and then with the farthest depth the box's visible surface reaches
+//! over it. The buffer can thus understate what the box hides, never
+//! overstate it.
+//!
+//! The box's outline on screen is convex, so a texel is inside it when
+//! its 4 corners are. The visible surface is the farthest of the front
+//! faces' planes at each point (a convex function), so over a texel it
+//! is farthest at one of the corners. Window depth is linear in screen
+//! space on each face, so the corner depths are exact.
+//!
+//! Occluders crossing the near plane are skipped rather than clipped;
+//! leaving them out can only make culling less aggressive, never wrong.
+//|____________________________________________________________________
+
+void OcclusionCuller::RasterizeBox(const Occluder& occ)
+{
+	float screen[8][3];
+	if (!ProjectBoxCorners(occ.clip_from_object, occ.box_min, occ.box_max, screen))
+		return;
+
+	// Texels whose 4 corners fall inside the box's screen bounds
+	float min_x = screen[0][0], max_x = screen[0][0];
+	float min_y = screen[0][1], max_y = screen[0][1];
+	for (int i = 1; i < 8; i++) {
+		min_x = std::min(min_x, screen[i][0]);
+		max_x = std::max(max_x, screen[i][0]);
+		min_y = std::min(min_y, screen[i][1]);
+		max_y = std::max(max_y, screen[i][1]);
+	}
+	const int x0 = (int)ceilf(std::max(min_x, 0.0f));
+	const int x1 = (int)floorf(std::min(max_x, (float)OCC_SIZE)) - 1;
+	const int y0 = (int)ceilf(std::max(min_y, 0.0f));
+	const int y1 = (int)floorf(std::min(max_y, (float)OCC_SIZE)) - 1;
+	if (x1 < x0 || y1 < y0)
+		return;
+
+	// Depth plane z = dzdx * x + dzdy * y + z0 of each face not seen edge-on
+	struct Face
+	{
+		const float* v[4];
+		float winding;
+		float dzdx, dzdy, z0;
+	};
+	Face faces[6];
+	int num_faces = 0;
+
+	for (int f = 0; f < 6; f++) {
+		Face& face = faces[num_faces];
+		for (int k = 0; k < 4; k++)
+			face.v[k] = screen[BOX_FACES[f][k]];
+
+		const float* a = face.v[0];
+		const float* b = face.v[1];
+		const float* c = face.v[2];
+		const float det = (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+		if (fabsf(det) < 1e-6f)
+			continue;
+
+		face.winding = det > 0.0f ? 1.0f : -1.0f;     // accept either winding
+		face.dzdx = ((b[2] - a[2]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[2] - a[2])) / det;
+		face.dzdy = ((b[0] - a[0]) * (c[2] - a[2]) - (b[2] - a[2]) * (c[0] - a[0])) / det;
+		face.z0 = a[2] - face.dzdx * a[0] - face.dzdy * a[1];
+		num_faces++;
+	}
+
+	// Depth of the visible surface at every texel corner: the nearest face
+	// over it. Corners outside every face stay OCC_UNCOVERED.
+	const int stride = OCC_SIZE + 1;
+	for (int y = y0; y <= y1 + 1; y++) {
+		for (int x = x0; x <= x1 + 1; x++) {
+			float z = OCC_UNCOVERED;
+			for (int f = 0; f < num_faces; f++) {
+				const Face& face = faces[f];
+				bool inside = true;
+				for (int k = 0; k < 4 && inside; k++) {
+					const float* p = face.v[k];
+					const float* q = face.v[(k + 1) & 3];
+					inside = face.winding * ((q[0] - p[0]) * (y - p[1]) - (q[1] - p[1]) * (x - p[0])) >= 0.0f;
+				}
+				if (inside)
+					z = std::min(z, face.dzdx * x + face.dzdy * y + face.z0);
+			}
+			corner_depth[y * stride + x] = z;
+		}
+	}
+
+	// Farthest corner of each texel; an uncovered corner is never nearer than what is stored
+	float* depth = Level(0);
+	for (int y = y0; y <= y1; y++) {
+		const float* row0 = &corner_depth[y * stride];
+		const float* row1 = row0 + stride;
+		for (int x = x0; x <= x1; x++) {
+			const float z = std::max(std::max(row0[x], row0[x + 1]), std::max(row1[x], row1[x + 1]));
+			float& d = depth[y * OCC_SIZE + x];
+			if (z < d)
+				d = z;
+		}
+	}
+}
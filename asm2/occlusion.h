@@ -0,0 +1,119 @@
+//|___________________________________________________________________
+//!
+//! \file occlusion.h
+//!
+//! \brief Hierarchical-Z occlusion culling done on the CPU.
+//!
+//! Each frame, the boxes of the nearest occluders (the solid turtle
+//! shells) are drawn into a small depth buffer, only where they cover
+//! a texel completely and at their farthest depth over it, so a visible
+//! object is never rejected. That buffer is reduced to a mip pyramid
+//! where each texel keeps the farthest depth below it.
+//! An object is rejected if its bounding box is behind that depth
+//! everywhere it covers on screen.
+//!
+//! Matrices are column-major float[16] (gmtl's mData layout) mapping
+//! object space to clip space, i.e. P * V * M.
+//|___________________________________________________________________
+
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+//|___________________
+//|
+//| Includes
+//|___________________
+
+#include <vector>
+
+//|___________________
+//|
+//| Constants
+//|___________________
+
+const int OCC_SIZE = 64;              // Depth buffer resolution (square, power of two)
+const int OCC_MAX_CANDIDATES = 64;    // Occluders offered per frame
+const int OCC_MAX_OCCLUDERS = 8;      // Nearest ones actually rasterized
+const int OCC_NO_OWNER = -1;          // Owner of a tested box that offered no occluder
+
+//|___________________
+//|
+//| Types
+//|___________________
+
+// Counters for the last frame, plus running totals
+struct OcclusionStats
+{
+	int occluders;          // occluders rasterized this frame
+	int tested;             // boxes tested this frame (not counting skipped ones)
+	int culled;             // boxes rejected this frame
+	double cull_ms;         // time from BeginFrame() to EndFrame() this frame
+
+	long long total_tested;
+	long long total_culled;
+	double total_cull_ms;
+	long long frames;
+};
+
+//|___________________
+//|
+//| Class: OcclusionCuller
+//|___________________
+
+class OcclusionCuller
+{
+public:
+	OcclusionCuller();
+
+	// Starts a frame: clears the depth buffer and the occluder list
+	void BeginFrame();
+
+	// Offers a solid box as an occluder. Only the OCC_MAX_OCCLUDERS nearest
+	// to the camera get rasterized. The box must lie inside drawn geometry.
+	// owner identifies the object it belongs to (e.g. the turtle index).
+	void AddOccluder(int owner, const float clip_from_object[16], const float box_min[3], const float box_max[3]);
+
+	// Rasterizes the chosen occluders and builds the depth pyramid
+	void BuildPyramid();
+
+	// True unless the box is known to be fully hidden by other owners'
+	// occluders. owner is the tested object's AddOccluder() owner, or
+	// OCC_NO_OWNER.
+	bool IsVisible(int owner, const float clip_from_object[16], const float box_min[3], const float box_max[3]);
+
+	// Closes the frame's stats. Everything between BeginFrame() and this
+	// counts as culling time, so callers do their culling-only work inside.
+	void EndFrame();
+
+	const OcclusionStats& Stats() const { return stats; }
+
+private:
+	struct Occluder
+	{
+		float clip_from_object[16];
+		float box_min[3];
+		float box_max[3];
+		float distance;     // clip w of the box centre (view-space depth)
+		int owner;
+	};
+
+	void RasterizeBox(const Occluder& occ);
+	float* Level(int level) { return &pyramid[level_offsets[level]]; }
+
+	std::vector<float> pyramid;           // all mip levels, level 0 first
+	int level_offsets[16];
+	int num_levels;
+
+	Occluder candidates[OCC_MAX_CANDIDATES];
+	int num_candidates;
+
+	int rasterized_owner;         // owner of the rasterized occluders, if they all share one
+	bool single_owner;
+
+	float corner_depth[(OCC_SIZE + 1) * (OCC_SIZE + 1)];   // RasterizeBox() scratch, one per texel corner
+	double frame_start_ms;
+
+	OcclusionStats stats;
+};
+
+#endif
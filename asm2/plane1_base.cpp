@@ -25,6 +25,18 @@
 //!	  u   = rolls the camera (+ Z-rot)
 //!	  o   = rolls the camera (- Z-rot)
 //!
+//!   t   = toggles the motion trails
+//!   c   = clears the motion trails
+//!
+//!   h   = toggles occlusion culling in the moving camera's view
+//!   p   = prints renderer stats to the console
+//!   m   = writes the latency histograms to latency_<buffering>[_finish].csv
+//!   r   = resets the latency histograms
+//!
+//! Command line options (for comparing presentation strategies):
+//!   -double   = double buffering with glutSwapBuffers() (default: single + glFlush())
+//!   -finish   = glFinish() after presenting, so the CPU never runs ahead of the GPU
+//!
 //! TODO: Extend the code to satisfy the requirements given in the assignment handout
 //!
 //! Note: Good programmer uses good comments! :)
@@ -36,11 +48,19 @@
 //|___________________
 
 #include <math.h>
+#include <stdio.h>
+#include <string.h>
 
 #include <gmtl/gmtl.h>
 
 #include <GL/glut.h>
 
+#include "frame_alloc.h"
+#include "gl_procs.h"
+#include "latency.h"
+#include "occlusion.h"
+#include "trail.h"
+
 //|___________________
 //|
 //| Constants
@@ -51,9 +71,28 @@ const float P_WIDTH = 1.5;
 const float P_LENGTH = 1.5;
 const float P_HEIGHT = 1.5;
 
+// Turtle extents in its local frame, enclosing everything DrawObject() draws
+const float TURTLE_BOX_MIN[3] = { -1.7f * P_WIDTH, -0.45f * P_HEIGHT, -1.35f * P_LENGTH };
+const float TURTLE_BOX_MAX[3] = { 1.7f * P_WIDTH, 0.45f * P_HEIGHT, 1.25f * P_LENGTH };
+
+// Outer shell box, solid so it hides whatever is behind it
+const float SHELL_BOX_MIN[3] = { -0.85f * P_WIDTH, -0.35f * P_HEIGHT, -1.0f * P_LENGTH };
+const float SHELL_BOX_MAX[3] = { 0.85f * P_WIDTH, 0.35f * P_HEIGHT, 1.0f * P_LENGTH };
+
+// Scratch memory per frame; steady-state frames must not touch the heap
+const size_t FRAME_ARENA_SIZE = 64 * 1024;
+
 // Camera's view frustum 
 const float CAM_FOV = 60.0f;     // Field of view in degs
 
+// Motion trails
+const int TRAIL_HISTORY = 512;         // Points kept per turtle; memory is fixed by this
+const float TRAIL_FADE = 1.5f;         // Alpha falloff exponent towards the oldest point (0 = no fade)
+const float TRAIL_SPACING = 0.25f;     // Min distance a turtle moves before a new point is kept
+
+// Keys that move the plane or the camera; only these are timed for input latency
+const char MOTION_KEYS[] = "sfxwdaeqk;,iljuo";
+
 //|___________________
 //|
 //| Global Variables
@@ -66,6 +105,10 @@ int w_height = 600;
 // Plane pose (position & orientation)
 gmtl::Matrix44f plane_pose; // T, as defined in the handout, initialized to IDENTITY by default
 
+// Turtles in the scene; each one leaves a motion trail
+const int NUM_TURTLES = 1;
+gmtl::Matrix44f* turtle_poses[NUM_TURTLES] = { &plane_pose };
+
 // Camera pose
 gmtl::Matrix44f cam_pose;   // C, as defined in the handout
 gmtl::Matrix44f view_mat;   // View transform is C^-1 (inverse of the camera transform C)
@@ -90,6 +133,23 @@ float colour_lime_green[3] = { 0.35f, 0.47f, 0.10f };
 float colour_light_lime_green[3] = { 0.45f, 0.57f, 0.20f };
 float colour_dark_gray[3] = { 0.2f, 0.2f, 0.2f };
 float colour_light_pink[3] = { 0.87f, 0.66f, 0.66f };
+float colour_trail[3] = { 0.95f, 0.95f, 0.55f };
+
+// Motion trails of the turtles
+MotionTrails trails;
+bool show_trails = true;
+
+// Occlusion culling for the moving camera's view
+OcclusionCuller culler;
+bool occlusion_culling = true;
+
+// Per-frame scratch memory, reset at the start of every DisplayFunc()
+FrameArena frame_arena(FRAME_ARENA_SIZE);
+
+// Input-to-photon latency, and how frames are presented
+LatencyTracker latency;
+bool double_buffered = false;
+bool finish_after_present = false;
 
 
 //|___________________
@@ -101,9 +161,14 @@ void InitMatrices();
 void InitGL(void);
 void DisplayFunc(void);
 void KeyboardFunc(unsigned char key, int x, int y);
+void IdleFunc(void);
 void ReshapeFunc(int w, int h);
 void DrawCoordinateFrame(const float l);
 void DrawObject(const float width, const float length, const float height);
+void DrawTrails();
+const bool* CullTurtles(const gmtl::Matrix44f& proj_mat, const gmtl::Matrix44f& view);
+void PrintStats();
+void WriteLatencyHistograms();
 
 //|____________________________________________________________________
 //|
@@ -208,6 +273,12 @@ void InitGL(void)
 	glClearColor(0.7f, 0.8f, 0.7f, 1.0f);
 	glEnable(GL_DEPTH_TEST);
 	glShadeModel(GL_SMOOTH);
+
+	// Trails need the buffer entry points, which only exist once there is a context
+	LoadGLProcs();
+	trails.Init(NUM_TURTLES, TRAIL_HISTORY, TRAIL_FADE, TRAIL_SPACING);
+	for (int i = 0; i < NUM_TURTLES; i++)
+		trails.SetColour(i, colour_trail);
 }
 
 //|____________________________________________________________________
@@ -225,6 +296,21 @@ void DisplayFunc(void)
 	// Modelview matrix
 	gmtl::Matrix44f modelview_mat;        // M, as defined in the handout
 
+	// Projection matrix, read back for the occlusion culler
+	gmtl::Matrix44f proj_mat;
+
+	// Everything temporary this frame comes from the arena from here on
+	frame_arena.Reset();
+	BeginFrameAllocCheck();
+
+	// This is the first frame to show the inputs that came in since the last one
+	latency.Poll();
+	latency.BeginFrame();
+
+	// Records where every turtle is now (its pose's origin, the 4th column)
+	for (int i = 0; i < NUM_TURTLES; i++)
+		trails.Record(i, &turtle_poses[i]->mData[12]);
+
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	//|____________________________________________________________________
@@ -238,6 +324,11 @@ void DisplayFunc(void)
 	glMatrixMode(GL_PROJECTION);
 	glLoadIdentity();
 	gluPerspective(CAM_FOV, (float)w_width / (2 * w_height), 0.1f, 100.0f);     // Check MSDN: google "gluPerspective msdn"
+	glGetFloatv(GL_PROJECTION_MATRIX, proj_mat.mData);
+	proj_mat.setState(gmtl::Matrix44f::FULL);
+
+	// Finds out which turtles are hidden behind other turtles' shells (NULL: none are)
+	const bool* turtle_visible = CullTurtles(proj_mat, view_mat);
 
 	// Approach1
 	glMatrixMode(GL_MODELVIEW);
@@ -247,12 +338,17 @@ void DisplayFunc(void)
 	modelview_mat = view_mat;                  // M = C^-1
 	glLoadMatrixf(modelview_mat.mData); // load input matrix into the target (modelview) matrix
 	DrawCoordinateFrame(10);
-
-	// Draws plane and its local frame
-	modelview_mat *= plane_pose;               // M = C^-1 * T
-	glLoadMatrixf(modelview_mat.mData);
-	DrawObject(P_WIDTH, P_LENGTH, P_HEIGHT);
-	DrawCoordinateFrame(3);
+	DrawTrails();                              // trail points are already in world space
+
+	// Draws the visible turtles, and every turtle's local frame since the
+	// axes reach past the box the culler tests
+	for (int i = 0; i < NUM_TURTLES; i++) {
+		modelview_mat = view_mat * *turtle_poses[i];   // M = C^-1 * T
+		glLoadMatrixf(modelview_mat.mData);
+		if (!turtle_visible || turtle_visible[i])
+			DrawObject(P_WIDTH, P_LENGTH, P_HEIGHT);
+		DrawCoordinateFrame(3);
+	}
 
 	/*
 	  // Approach 2 (gives the same results as the approach 1)
@@ -286,19 +382,35 @@ void DisplayFunc(void)
 	modelview_mat = view_mat_fixed;			// M = F^-1
 	glLoadMatrixf(modelview_mat.mData);
 	DrawCoordinateFrame(10);
-
-	// Draws plane and its local frame
-	modelview_mat *= plane_pose;               // M = F^-1 * T
-	glLoadMatrixf(modelview_mat.mData);
-	DrawObject(P_WIDTH, P_LENGTH, P_HEIGHT);
-	DrawCoordinateFrame(3);
+	DrawTrails();
+
+	// Draws the turtles and their local frames
+	for (int i = 0; i < NUM_TURTLES; i++) {
+		modelview_mat = view_mat_fixed * *turtle_poses[i];   // M = F^-1 * T
+		glLoadMatrixf(modelview_mat.mData);
+		DrawObject(P_WIDTH, P_LENGTH, P_HEIGHT);
+		DrawCoordinateFrame(3);
+	}
 
 	// Draws movable camera
 	modelview_mat = view_mat_fixed * cam_pose;   // M = F^-1 * C
 	glLoadMatrixf(modelview_mat.mData);
 	DrawCoordinateFrame(1);
 
-	glFlush();
+	trails.EndFrame();
+
+	if (double_buffered)
+		glutSwapBuffers();
+	else
+		glFlush();
+	if (finish_after_present)
+		glFinish();
+
+	// Fences the frame; IdleFunc() watches the fence while nothing else is drawn
+	latency.EndFrame();
+	glutIdleFunc(latency.Pending() ? IdleFunc : NULL);
+
+	EndFrameAllocCheck();
 }
 
 //|____________________________________________________________________
@@ -313,6 +425,9 @@ void DisplayFunc(void)
 
 void KeyboardFunc(unsigned char key, int x, int y)
 {
+	if (key && strchr(MOTION_KEYS, key))
+		latency.OnInput();                  // stamp before anything else happens
+
 	switch (key) {
 		//|____________________________________________________________________
 		//|
@@ -391,12 +506,61 @@ void KeyboardFunc(unsigned char key, int x, int y)
 	case 'o': // Rolls the camera (- Z-rot)
 		cam_pose = cam_pose * zrotn_mat;
 		break;
+
+	//|____________________________________________________________________
+	//|
+	//| Trail controls
+	//|____________________________________________________________________
+
+	case 't': // Shows/hides the motion trails
+		show_trails = !show_trails;
+		break;
+	case 'c': // Clears the motion trails
+		trails.Clear();
+		break;
+
+	//|____________________________________________________________________
+	//|
+	//| Debug controls
+	//|____________________________________________________________________
+
+	case 'h': // Turns occlusion culling on/off
+		occlusion_culling = !occlusion_culling;
+		break;
+	case 'p': // Prints renderer stats
+		PrintStats();
+		break;
+	case 'm': // Writes the latency histograms to a file
+		WriteLatencyHistograms();
+		break;
+	case 'r': // Starts the latency histograms over
+		latency.Reset();
+		break;
 	}
 
 	gmtl::invert(view_mat, cam_pose);       // Updates view transform to reflect the change in camera transform
 	glutPostRedisplay();                    // Asks GLUT to redraw the screen
 }
 
+//|____________________________________________________________________
+//|
+//| Function: IdleFunc
+//|
+//! \param None.
+//! \return None.
+//!
+//! GLUT idle callback function: only registered while a presented frame
+//! is waiting on its latency fence, so the completion time is caught as
+//! soon as the GPU is done.
+//|____________________________________________________________________
+
+void IdleFunc(void)
+{
+	latency.Poll();
+	if (!latency.Pending())
+		glutIdleFunc(NULL);
+}
+
 //|____________________________________________________________________
 //|
 //| Function: ReshapeFunc
@@ -444,6 +608,158 @@ void DrawCoordinateFrame(const float l)
 	glEnd();
 }
 
+//|____________________________________________________________________
+//|
+//| Function: DrawTrails
+//|
+//! \param None.
+//! \return None.
+//!
+//! Draws the motion trail of every turtle. Expects the modelview matrix
+//! to hold the view transform only.
+//|____________________________________________________________________
+
+void DrawTrails()
+{
+	if (!show_trails)
+		return;
+
+	for (int i = 0; i < NUM_TURTLES; i++)
+		trails.Draw(i);
+}
+
+//|____________________________________________________________________
+//|
+//| Function: CullTurtles
+//|
+//! \param proj_mat   [in] Projection matrix of the viewport.
+//! \param view       [in] View matrix of the viewport.
+//! \return Visibility of each turtle, valid until the end of the frame,
+//!         or NULL if every turtle is to be drawn.
+//!
+//! The nearest turtles' shells are rasterized as occluders, then every
+//! turtle's bounding box is tested against the other turtles' shells.
+//! With culling off, or if the frame arena is out of space, nothing is
+//! culled.
+//!
+//! Note: with NUM_TURTLES = 1 there is no other shell to hide behind,
+//! so nothing is ever culled and the work here is pure overhead until
+//! more turtles are added.
+//|____________________________________________________________________
+
+const bool* CullTurtles(const gmtl::Matrix44f& proj_mat, const gmtl::Matrix44f& view)
+{
+	if (!occlusion_culling)
+		return NULL;
+
+	// Timed from here, so the matrix products count as culling work
+	culler.BeginFrame();
+
+	// P * C^-1 * T of every turtle; a full arena (only asserted in Debug) disables culling
+	bool* turtle_visible = frame_arena.Alloc<bool>(NUM_TURTLES);
+	gmtl::Matrix44f* clip_mats = frame_arena.Alloc<gmtl::Matrix44f>(NUM_TURTLES);
+	if (!turtle_visible || !clip_mats) {
+		culler.EndFrame();
+		return NULL;
+	}
+
+	for (int i = 0; i < NUM_TURTLES; i++) {
+		clip_mats[i] = proj_mat * view * *turtle_poses[i];
+		culler.AddOccluder(i, clip_mats[i].mData, SHELL_BOX_MIN, SHELL_BOX_MAX);
+	}
+	culler.BuildPyramid();
+
+	for (int i = 0; i < NUM_TURTLES; i++)
+		turtle_visible[i] = culler.IsVisible(i, clip_mats[i].mData, TURTLE_BOX_MIN, TURTLE_BOX_MAX);
+	culler.EndFrame();
+
+	return turtle_visible;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: PrintStats
+//|
+//! \param None.
+//! \return None.
+//!
+//! Prints the renderer's counters to the console.
+//|____________________________________________________________________
+
+void PrintStats()
+{
+	const OcclusionStats& occ = culler.Stats();
+	printf("Occlusion culling (%s)\n", occlusion_culling ? "on" : "off");
+	printf("  last frame: %d occluders, %d tested, %d culled, %.3f ms\n",
+		occ.occluders, occ.tested, occ.culled, occ.cull_ms);
+	printf("  total:      %lld frames, %lld tested, %lld culled, %.3f ms\n",
+		occ.frames, occ.total_tested, occ.total_culled, occ.total_cull_ms);
+
+	printf("Frame memory\n");
+	printf("  arena:      %zu / %zu bytes at peak\n", frame_arena.HighWater(), frame_arena.Capacity());
+	if (FrameAllocCheckEnabled()) {
+		const FrameAllocStats& heap = GetFrameAllocStats();
+		printf("  heap:       %lld of %lld frames allocated, %lld allocations, %zu bytes\n",
+			heap.dirty_frames, heap.frames, heap.allocs, heap.bytes);
+	}
+	else {
+		printf("  heap:       not checked (build with FRAME_ALLOC_CHECK)\n");
+	}
+
+	const LatencyHistogram& submit = latency.InputToSubmit();
+	const LatencyHistogram& complete = latency.InputToComplete();
+	printf("Input latency (%s buffered%s)\n", double_buffered ? "double" : "single",
+		finish_after_present ? ", glFinish" : "");
+	printf("  to submit:   %lld samples, p50 %.1f ms, p95 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+		submit.Count(), submit.Percentile(0.50), submit.Percentile(0.95), submit.Percentile(0.99), submit.Max());
+	if (latency.UsesFences()) {
+		printf("  to complete: %lld samples, p50 %.1f ms, p95 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+			complete.Count(), complete.Percentile(0.50), complete.Percentile(0.95), complete.Percentile(0.99), complete.Max());
+	}
+	else {
+		printf("  to complete: not measured (no fence sync support)\n");
+	}
+	if (latency.Dropped())
+		printf("  dropped:     %lld samples\n", latency.Dropped());
+}
+
+//|____________________________________________________________________
+//|
+//| Function: WriteLatencyHistograms
+//|
+//! \param None.
+//! \return None.
+//!
+//! Writes both latency histograms to latency_<buffering>[_finish].csv,
+//! so runs with each buffering and pacing mode can be compared side by
+//! side. The first line also records the mode.
+//|____________________________________________________________________
+
+void WriteLatencyHistograms()
+{
+	// Indexed by [double_buffered][finish_after_present]
+	const char* const FILE_NAMES[2][2] = {
+		{ "latency_single.csv", "latency_single_finish.csv" },
+		{ "latency_double.csv", "latency_double_finish.csv" },
+	};
+	const char* file_name = FILE_NAMES[double_buffered][finish_after_present];
+	FILE* file = NULL;
+	if (fopen_s(&file, file_name, "w") != 0 || !file) {
+		printf("Could not write %s\n", file_name);
+		return;
+	}
+
+	fprintf(file, "# double_buffered=%d finish_after_present=%d fences=%d\n",
+		double_buffered, finish_after_present, latency.UsesFences());
+	fprintf(file, "# input to submit\n");
+	latency.InputToSubmit().WriteCSV(file);
+	fprintf(file, "# input to complete\n");
+	latency.InputToComplete().WriteCSV(file);
+	fclose(file);
+
+	printf("Wrote %s\n", file_name);
+}
+
 //|____________________________________________________________________
 //|
 //| Function: DrawPlane
@@ -616,7 +932,15 @@ int main(int argc, char** argv)
 
 	glutInit(&argc, argv);
 
-	glutInitDisplayMode(GLUT_SINGLE | GLUT_RGB | GLUT_DEPTH);
+	// glutInit() has removed its own options; the rest are ours
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-double") == 0)
+			double_buffered = true;
+		else if (strcmp(argv[i], "-finish") == 0)
+			finish_after_present = true;
+	}
+
+	glutInitDisplayMode((double_buffered ? GLUT_DOUBLE : GLUT_SINGLE) | GLUT_RGB | GLUT_DEPTH);
 	glutInitWindowSize(w_width, w_height);
 
 	glutCreateWindow("Sea Turtle Plane Episode 1");
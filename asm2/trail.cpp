@@ -0,0 +1,370 @@
+//|___________________________________________________________________
+//!
+//! \file trail.cpp
+//!
+//! \brief Motion trails showing where each turtle has been.
+//|___________________________________________________________________
+
+//|___________________
+//|
+//| Includes
+//|___________________
+
+#include "trail.h"
+
+#include <math.h>
+
+//|___________________
+//|
+//| Constants
+//|___________________
+
+const float TRAIL_DEFAULT_COLOUR[3] = { 1.0f, 1.0f, 1.0f };
+const float TRAIL_LINE_WIDTH = 2.0f;
+
+//|____________________________________________________________________
+//|
+//| Function: MotionTrails::MotionTrails
+//|____________________________________________________________________
+
+MotionTrails::MotionTrails()
+	: num_trails(0), capacity(0), ring_size(0), fade(0.0f), min_spacing(0.0f),
+	positions(NULL), colours(NULL), colours_offset(0),
+	persistent(false), buffer(0), frame_slot(0)
+{
+	for (int i = 0; i < TRAIL_FRAMES_IN_FLIGHT; i++)
+		fences[i] = NULL;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: MotionTrails::Init
+//|
+//! \param num_trails    [in] Number of trails (one per turtle).
+//! \param history_len   [in] Points kept per trail.
+//! \param fade          [in] Alpha ramp exponent, 0 disables fading.
+//! \param min_spacing   [in] Minimum distance between recorded points.
+//! \return None.
+//!
+//! Allocates the shared storage once; nothing is reallocated afterwards.
+//|____________________________________________________________________
+
+void MotionTrails::Init(int num_trails, int history_len, float fade, float min_spacing)
+{
+	Shutdown();
+
+	this->num_trails = num_trails;
+	this->capacity = history_len < 2 ? 2 : history_len;
+	this->ring_size = capacity + TRAIL_SPARE_SLOTS;
+	this->fade = fade;
+	this->min_spacing = min_spacing;
+
+	heads.assign(num_trails, 0);
+	counts.assign(num_trails, 0);
+
+	const size_t num_position_floats = (size_t)num_trails * (ring_size + 1) * 3;
+	const size_t num_colour_floats = (size_t)num_trails * capacity * 4;
+	const size_t total_bytes = (num_position_floats + num_colour_floats) * sizeof(float);
+	colours_offset = num_position_floats * sizeof(float);
+
+	persistent = HasBufferStorage();
+	if (persistent) {
+		glprocGenBuffers(1, &buffer);
+		glprocBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glprocBufferStorage(GL_ARRAY_BUFFER, (ptrdiff_t)total_bytes, NULL, flags);
+		positions = (float*)glprocMapBufferRange(GL_ARRAY_BUFFER, 0, (ptrdiff_t)total_bytes, flags);
+		glprocBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		if (!positions) {                               // mapping refused, fall back to client memory
+			glprocDeleteBuffers(1, &buffer);
+			buffer = 0;
+			persistent = false;
+		}
+	}
+	if (!persistent) {
+		client_storage.assign(num_position_floats + num_colour_floats, 0.0f);
+		positions = &client_storage[0];
+	}
+	colours = positions + num_position_floats;
+
+	for (int i = 0; i < num_trails; i++)
+		SetColour(i, TRAIL_DEFAULT_COLOUR);
+}
+
+//|____________________________________________________________________
+//|
+//| Function: MotionTrails::Shutdown
+//|
+//! \param None.
+//! \return None.
+//!
+//! Releases the GL buffer and fences. Needs a current GL context.
+//|____________________________________________________________________
+
+void MotionTrails::Shutdown()
+{
+	if (persistent) {
+		WaitForIdle();
+		glprocBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glprocUnmapBuffer(GL_ARRAY_BUFFER);
+		glprocBindBuffer(GL_ARRAY_BUFFER, 0);
+		glprocDeleteBuffers(1, &buffer);
+	}
+
+	client_storage.clear();
+	heads.clear();
+	counts.clear();
+	positions = NULL;
+	colours = NULL;
+	persistent = false;
+	buffer = 0;
+	num_trails = 0;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: MotionTrails::SetColour
+//|
+//! \param trail    [in] Trail index.
+//! \param colour   [in] RGB colour of the newest point.
+//! \return None.
+//!
+//! Rebuilds the trail's colour ramp. Entry [capacity - 1] belongs to the
+//! newest point and is fully opaque; alpha falls off towards entry 0.
+//|____________________________________________________________________
+
+void MotionTrails::SetColour(int trail, const float colour[3])
+{
+	for (int age = 0; age < capacity; age++) {
+		const float t = (float)(age + 1) / capacity;   // (0, 1], 1 = newest
+		float* c = Colour(trail, age);
+		c[0] = colour[0];
+		c[1] = colour[1];
+		c[2] = colour[2];
+		c[3] = fade > 0.0f ? powf(t, fade) : 1.0f;
+	}
+}
+
+//|____________________________________________________________________
+//|
+//| Function: MotionTrails::Record
+//|
+//! \param trail   [in] Trail index.
+//! \param pos     [in] World-space position.
+//! \return None.
+//!
+//! Appends a point, overwriting the oldest slot once the ring is full.
+//! Points closer than min_spacing to the previous one are skipped so a
+//! turtle sitting still does not flush its own history.
+//!
+//! At most one point per trail is recorded per frame, so the slot being
+//! overwritten has been out of the drawn range for at least
+//! TRAIL_SPARE_SLOTS + 1 frames; waiting on the fence from
+//! TRAIL_FRAMES_IN_FLIGHT frames back covers it.
+//|____________________________________________________________________
+
+void MotionTrails::Record(int trail, const float pos[3])
+{
+	if (trail < 0 || trail >= num_trails)
+		return;
+
+	int& head = heads[trail];
+	int& count = counts[trail];
+
+	if (count > 0) {
+		const float* last = Vertex(trail, (head + ring_size - 1) % ring_size);
+		const float dx = pos[0] - last[0];
+		const float dy = pos[1] - last[1];
+		const float dz = pos[2] - last[2];
+		if (dx * dx + dy * dy + dz * dz < min_spacing * min_spacing)
+			return;
+	}
+
+	WaitForFrameSlot();
+
+	float* v = Vertex(trail, head);
+	v[0] = pos[0];
+	v[1] = pos[1];
+	v[2] = pos[2];
+
+	if (head == 0) {                                    // keep the seam mirror in step
+		float* mirror = Vertex(trail, ring_size);
+		mirror[0] = pos[0];
+		mirror[1] = pos[1];
+		mirror[2] = pos[2];
+	}
+
+	head = (head + 1) % ring_size;
+	if (count < capacity)
+		count++;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: MotionTrails::Clear
+//|
+//! \param None.
+//! \return None.
+//!
+//! Forgets all recorded points (storage is kept). The heads stay where
+//! they are, so new points still go into slots the GPU is done with.
+//|____________________________________________________________________
+
+void MotionTrails::Clear()
+{
+	for (int i = 0; i < num_trails; i++)
+		counts[i] = 0;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: MotionTrails::Draw
+//|
+//! \param trail   [in] Trail index.
+//! \return None.
+//!
+//! Draws the newest count points of the trail, oldest to newest. If
+//! they wrap around the ring they are drawn as two strips,
+//! [start, ring_size] then [0, head), so nothing is copied; the colour
+//! pointer is offset so each point still gets its age's alpha.
+//|____________________________________________________________________
+
+void MotionTrails::Draw(int trail) const
+{
+	if (trail < 0 || trail >= num_trails || counts[trail] < 2)
+		return;
+
+	const int head = heads[trail];
+	const int count = counts[trail];
+	const int start = (head - count + ring_size) % ring_size;
+
+	// With a bound buffer, pointers are byte offsets into it
+	const char* base = persistent ? (const char*)NULL : (const char*)positions;
+	const char* pos_base = base + (Vertex(trail, 0) - positions) * sizeof(float);
+	const char* col_base = base + colours_offset + (Colour(trail, 0) - colours) * sizeof(float);
+
+	// Ramp entry of the oldest drawn point; the newest gets [capacity - 1]
+	const char* col_oldest = col_base + (capacity - count) * 4 * sizeof(float);
+
+	glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_LINE_BIT);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glLineWidth(TRAIL_LINE_WIDTH);
+
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	if (persistent)
+		glprocBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+	if (start + count <= ring_size) {
+		// Contiguous: slots [start, start + count)
+		glVertexPointer(3, GL_FLOAT, 0, pos_base + start * 3 * sizeof(float));
+		glColorPointer(4, GL_FLOAT, 0, col_oldest);
+		glDrawArrays(GL_LINE_STRIP, 0, count);
+	}
+	else {
+		// Oldest part [start, ring_size], the last slot being the mirror of slot 0
+		const int n_old = ring_size - start + 1;
+		glVertexPointer(3, GL_FLOAT, 0, pos_base + start * 3 * sizeof(float));
+		glColorPointer(4, GL_FLOAT, 0, col_oldest);
+		glDrawArrays(GL_LINE_STRIP, 0, n_old);
+
+		// Newest part [0, head), starting again from slot 0's point
+		if (head > 1) {
+			glVertexPointer(3, GL_FLOAT, 0, pos_base);
+			glColorPointer(4, GL_FLOAT, 0, col_oldest + (n_old - 1) * 4 * sizeof(float));
+			glDrawArrays(GL_LINE_STRIP, 0, head);
+		}
+	}
+
+	if (persistent)
+		glprocBindBuffer(GL_ARRAY_BUFFER, 0);
+	glPopClientAttrib();
+	glPopAttrib();
+}
+
+//|____________________________________________________________________
+//|
+//| Function: MotionTrails::EndFrame
+//|
+//! \param None.
+//! \return None.
+//!
+//! Drops a fence behind this frame's trail draws. It replaces the one
+//! from TRAIL_FRAMES_IN_FLIGHT frames back if no Record() needed it;
+//! frames complete in order, so the newer fence covers the older one.
+//|____________________________________________________________________
+
+void MotionTrails::EndFrame()
+{
+	if (!persistent)
+		return;
+
+	GlSyncHandle& fence = fences[frame_slot];
+	if (fence)
+		glprocDeleteSync(fence);
+	fence = glprocFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	frame_slot = (frame_slot + 1) % TRAIL_FRAMES_IN_FLIGHT;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: MotionTrails::WaitForFrameSlot
+//|
+//! \param None.
+//! \return None.
+//!
+//! Blocks until the frame TRAIL_FRAMES_IN_FLIGHT frames back has been
+//! finished by the GPU. Only the first call in a frame can wait; unless
+//! the GPU falls that far behind, the fence has long signalled.
+//|____________________________________________________________________
+
+void MotionTrails::WaitForFrameSlot()
+{
+	GlSyncHandle& fence = fences[frame_slot];
+	if (!persistent || !fence)
+		return;
+
+	WaitForFence(fence);                                // a failed wait leaves nothing to wait for either
+	glprocDeleteSync(fence);
+	fence = NULL;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: MotionTrails::WaitForIdle
+//|
+//! \param None.
+//! \return None.
+//!
+//! Blocks until every fenced frame is done. Only used on shutdown.
+//|____________________________________________________________________
+
+void MotionTrails::WaitForIdle()
+{
+	for (int i = 0; i < TRAIL_FRAMES_IN_FLIGHT; i++) {
+		WaitForFrameSlot();
+		frame_slot = (frame_slot + 1) % TRAIL_FRAMES_IN_FLIGHT;
+	}
+}
+
+//|____________________________________________________________________
+//|
+//| Function: MotionTrails::Vertex / MotionTrails::Colour
+//|
+//! Address of a position slot / colour ramp entry of a trail.
+//|____________________________________________________________________
+
+float* MotionTrails::Vertex(int trail, int index) const
+{
+	return positions + ((size_t)trail * (ring_size + 1) + index) * 3;
+}
+
+float* MotionTrails::Colour(int trail, int age) const
+{
+	return colours + ((size_t)trail * capacity + age) * 4;
+}
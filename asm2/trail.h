@@ -0,0 +1,103 @@
+//|___________________________________________________________________
+//!
+//! \file trail.h
+//!
+//! \brief Motion trails showing where each turtle has been.
+//!
+//! Every trail is a fixed-size ring of world-space positions, so memory
+//! stays the same no matter how long the program runs. All trails share
+//! one vertex buffer. If the driver supports GL_ARB_buffer_storage, that
+//! buffer stays mapped and new positions are written straight into it.
+//! Otherwise the trails are drawn from client memory.
+//!
+//! Writing into the mapped buffer never waits on the frame just drawn:
+//! each ring holds TRAIL_SPARE_SLOTS points more than are drawn, so the
+//! slot being overwritten was last read TRAIL_FRAMES_IN_FLIGHT or more
+//! frames ago, and only that frame's fence is waited on.
+//|___________________________________________________________________
+
+#ifndef TRAIL_H
+#define TRAIL_H
+
+//|___________________
+//|
+//| Includes
+//|___________________
+
+#include <vector>
+
+#include "gl_procs.h"
+
+//|___________________
+//|
+//| Constants
+//|___________________
+
+const int TRAIL_FRAMES_IN_FLIGHT = 3;                         // frames the GPU may lag behind before Record() waits
+const int TRAIL_SPARE_SLOTS = TRAIL_FRAMES_IN_FLIGHT;          // undrawn slots per ring; at least TRAIL_FRAMES_IN_FLIGHT - 1
+
+//|___________________
+//|
+//| Class: MotionTrails
+//|___________________
+
+class MotionTrails
+{
+public:
+	MotionTrails();
+
+	// Allocates storage for num_trails trails of history_len points each.
+	// fade is the exponent of the alpha ramp (0 = no fade, 1 = linear).
+	// min_spacing is how far a turtle must move before a new point is kept.
+	// Needs a current GL context.
+	void Init(int num_trails, int history_len, float fade, float min_spacing);
+	void Shutdown();
+
+	// Sets the colour of the newest point. Meant for setup: the colour
+	// ramp is read by every frame and is not fenced.
+	void SetColour(int trail, const float colour[3]);
+
+	// Appends a point to a trail; call at most once per trail per frame
+	void Record(int trail, const float pos[3]);
+	void Clear();
+
+	// Draws one trail as line strips in world space (load the view matrix first)
+	void Draw(int trail) const;
+
+	// Fences the frame's draws so a later Record() does not overwrite
+	// vertices the GPU is still reading. Call once after all viewports.
+	void EndFrame();
+
+	bool IsPersistent() const { return persistent; }
+
+private:
+	float* Vertex(int trail, int index) const;
+	float* Colour(int trail, int age) const;
+	void WaitForFrameSlot();
+	void WaitForIdle();
+
+	int num_trails;
+	int capacity;                 // points drawn per trail
+	int ring_size;                // slots per trail, capacity + TRAIL_SPARE_SLOTS
+	float fade;
+	float min_spacing;
+
+	// Per trail ring state
+	std::vector<int> heads;       // slot the next point goes into
+	std::vector<int> counts;      // points recorded since the last Clear(), up to capacity
+
+	// Shared vertex storage: positions first, colour ramps after.
+	// Each trail has ring_size + 1 position slots; the extra slot mirrors
+	// slot 0 so a wrapped ring can be drawn without a gap at the seam.
+	float* positions;
+	float* colours;
+	size_t colours_offset;        // byte offset of the colours inside the buffer
+	std::vector<float> client_storage;
+
+	bool persistent;
+	GLuint buffer;
+	GlSyncHandle fences[TRAIL_FRAMES_IN_FLIGHT];   // one per frame, oldest at frame_slot
+	int frame_slot;                                // fence slot the current frame will fill
+};
+
+#endif
@@ -0,0 +1,294 @@
+//|___________________________________________________________________
+//!
+//! \file batch_xform_bench.cpp
+//!
+//! \brief Benchmarks the batch transform kernels against plain gmtl.
+//!
+//! For every operation and batch size, each kernel set the CPU supports
+//! is timed against a loop of the per-element gmtl calls, and its
+//! results are checked against gmtl's. Exits with 1 if any kernel
+//! disagrees with gmtl by more than TOLERANCE.
+//!
+//! Usage: batch_xform_bench
+//|___________________________________________________________________
+
+//|___________________
+//|
+//| Includes
+//|___________________
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <vector>
+
+#include <gmtl/gmtl.h>
+
+#include "../asm2/batch_xform.h"
+
+//|___________________
+//|
+//| Constants
+//|___________________
+
+const size_t BATCH_SIZES[] = { 1, 7, 64, 1024, 16384, 262144 };
+const size_t ELEMENTS_PER_TIMING = 1 << 22;   // each timing repeats the batch up to this many elements
+const int TIMING_RUNS = 5;                     // best of
+const float TOLERANCE = 1e-4f;                 // max |batch - gmtl| / max(1, |gmtl|)
+const float COORD_RANGE = 10.0f;               // random points and translations in [-range, range]
+
+//|___________________
+//|
+//| Global Variables
+//|___________________
+
+// Results are folded in here so the compiler cannot drop the timed loops
+volatile float sink = 0.0f;
+
+//|____________________________________________________________________
+//|
+//| Function: RandomFloat / RandomRigid
+//|
+//! Random inputs; the seed is fixed so runs are comparable.
+//|____________________________________________________________________
+
+float RandomFloat(float lo, float hi)
+{
+	return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+}
+
+gmtl::Matrix44f RandomRigid()
+{
+	const float pi = gmtl::Math::deg2Rad(180.0f);
+	gmtl::Matrix44f rot = gmtl::makeRot<gmtl::Matrix44f>(
+		gmtl::EulerAngleXYZf(RandomFloat(-pi, pi), RandomFloat(-pi, pi), RandomFloat(-pi, pi)));
+	gmtl::Matrix44f trans = gmtl::makeTrans<gmtl::Matrix44f>(gmtl::Vec3f(
+		RandomFloat(-COORD_RANGE, COORD_RANGE), RandomFloat(-COORD_RANGE, COORD_RANGE), RandomFloat(-COORD_RANGE, COORD_RANGE)));
+
+	gmtl::Matrix44f pose = trans * rot;
+	pose.setState(gmtl::Matrix44f::AFFINE);
+	return pose;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: RelError
+//|
+//! \return Error of a against the reference b, relative above magnitude 1.
+//|____________________________________________________________________
+
+float RelError(const float* a, const float* b, int n)
+{
+	float err = 0.0f;
+	for (int i = 0; i < n; i++) {
+		const float scale = fabsf(b[i]) > 1.0f ? fabsf(b[i]) : 1.0f;
+		const float e = fabsf(a[i] - b[i]) / scale;
+		if (!(e <= err))              // also catches NaN
+			err = e;
+	}
+	return err;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: NsPerElement
+//|
+//! \param run   [in] Processes one whole batch.
+//! \param n     [in] Batch size.
+//! \return Best time per element over TIMING_RUNS, in nanoseconds.
+//|____________________________________________________________________
+
+template <typename Run>
+double NsPerElement(Run run, size_t n)
+{
+	using namespace std::chrono;
+
+	const size_t reps = n < ELEMENTS_PER_TIMING ? ELEMENTS_PER_TIMING / n : 1;
+	double best = 1e30;
+
+	for (int t = 0; t < TIMING_RUNS; t++) {
+		const steady_clock::time_point start = steady_clock::now();
+		for (size_t r = 0; r < reps; r++)
+			run();
+		const double ns = duration<double, std::nano>(steady_clock::now() - start).count();
+		if (ns < best)
+			best = ns;
+	}
+	return best / ((double)reps * n);
+}
+
+//|____________________________________________________________________
+//|
+//| Function: Report
+//|
+//! Prints one result line; returns false if the error is over TOLERANCE.
+//|____________________________________________________________________
+
+bool Report(const char* op, size_t n, const char* impl, double ns, double gmtl_ns, float err)
+{
+	const bool ok = err <= TOLERANCE;
+	printf("%-8s %8lu  %-6s %9.2f ns  %6.2fx  err %.1e  %s\n",
+		op, (unsigned long)n, impl, ns, gmtl_ns / ns, err, ok ? "ok" : "MISMATCH");
+	return ok;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: BenchPoints / BenchVectors / BenchCompose / BenchInvert
+//|
+//! \param n   [in] Batch size.
+//! \return False if any kernel set disagrees with gmtl.
+//|____________________________________________________________________
+
+bool BenchPoints(size_t n)
+{
+	const gmtl::Matrix44f m = RandomRigid();
+	std::vector<gmtl::Point3f> in(n), ref(n), out(n);
+	for (size_t i = 0; i < n; i++)
+		in[i] = gmtl::Point3f(RandomFloat(-COORD_RANGE, COORD_RANGE), RandomFloat(-COORD_RANGE, COORD_RANGE), RandomFloat(-COORD_RANGE, COORD_RANGE));
+
+	const double gmtl_ns = NsPerElement([&]() {
+		for (size_t i = 0; i < n; i++)
+			ref[i] = m * in[i];
+		sink = sink + ref[0][0];
+	}, n);
+	Report("points", n, "gmtl", gmtl_ns, gmtl_ns, 0.0f);
+
+	bool ok = true;
+	for (int isa = 0; isa < BATCH_NUM_ISAS; isa++) {
+		if (!SetBatchIsa((BatchIsa)isa))
+			continue;
+		const double ns = NsPerElement([&]() {
+			XformPoints(m, &in[0], &out[0], n);
+			sink = sink + out[0][0];
+		}, n);
+		ok &= Report("points", n, BatchIsaName((BatchIsa)isa), ns, gmtl_ns,
+			RelError(out[0].mData, ref[0].mData, (int)(3 * n)));
+	}
+	return ok;
+}
+
+bool BenchVectors(size_t n)
+{
+	const gmtl::Matrix44f m = RandomRigid();
+	std::vector<gmtl::Vec3f> in(n), ref(n), out(n);
+	for (size_t i = 0; i < n; i++)
+		in[i] = gmtl::Vec3f(RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f));
+
+	const double gmtl_ns = NsPerElement([&]() {
+		for (size_t i = 0; i < n; i++)
+			ref[i] = m * in[i];
+		sink = sink + ref[0][0];
+	}, n);
+	Report("vectors", n, "gmtl", gmtl_ns, gmtl_ns, 0.0f);
+
+	bool ok = true;
+	for (int isa = 0; isa < BATCH_NUM_ISAS; isa++) {
+		if (!SetBatchIsa((BatchIsa)isa))
+			continue;
+		const double ns = NsPerElement([&]() {
+			XformVectors(m, &in[0], &out[0], n);
+			sink = sink + out[0][0];
+		}, n);
+		ok &= Report("vectors", n, BatchIsaName((BatchIsa)isa), ns, gmtl_ns,
+			RelError(out[0].mData, ref[0].mData, (int)(3 * n)));
+	}
+	return ok;
+}
+
+bool BenchCompose(size_t n)
+{
+	std::vector<gmtl::Matrix44f> lhs(n), rhs(n), ref(n), out(n);
+	for (size_t i = 0; i < n; i++) {
+		lhs[i] = RandomRigid();
+		rhs[i] = RandomRigid();
+	}
+
+	const double gmtl_ns = NsPerElement([&]() {
+		for (size_t i = 0; i < n; i++)
+			ref[i] = lhs[i] * rhs[i];
+		sink = sink + ref[0].mData[0];
+	}, n);
+	Report("compose", n, "gmtl", gmtl_ns, gmtl_ns, 0.0f);
+
+	bool ok = true;
+	for (int isa = 0; isa < BATCH_NUM_ISAS; isa++) {
+		if (!SetBatchIsa((BatchIsa)isa))
+			continue;
+		const double ns = NsPerElement([&]() {
+			ComposeMatrices(&lhs[0], &rhs[0], &out[0], n);
+			sink = sink + out[0].mData[0];
+		}, n);
+
+		float err = 0.0f;
+		for (size_t i = 0; i < n; i++) {
+			const float e = RelError(out[i].mData, ref[i].mData, 16);
+			if (!(e <= err))
+				err = e;
+		}
+		ok &= Report("compose", n, BatchIsaName((BatchIsa)isa), ns, gmtl_ns, err);
+	}
+	return ok;
+}
+
+bool BenchInvert(size_t n)
+{
+	std::vector<gmtl::Matrix44f> in(n), ref(n), out(n);
+	for (size_t i = 0; i < n; i++)
+		in[i] = RandomRigid();
+
+	const double gmtl_ns = NsPerElement([&]() {
+		for (size_t i = 0; i < n; i++)
+			gmtl::invert(ref[i], in[i]);
+		sink = sink + ref[0].mData[0];
+	}, n);
+	Report("invert", n, "gmtl", gmtl_ns, gmtl_ns, 0.0f);
+
+	bool ok = true;
+	for (int isa = 0; isa < BATCH_NUM_ISAS; isa++) {
+		if (!SetBatchIsa((BatchIsa)isa))
+			continue;
+		const double ns = NsPerElement([&]() {
+			InvertRigid(&in[0], &out[0], n);
+			sink = sink + out[0].mData[0];
+		}, n);
+
+		float err = 0.0f;
+		for (size_t i = 0; i < n; i++) {
+			const float e = RelError(out[i].mData, ref[i].mData, 16);
+			if (!(e <= err))
+				err = e;
+		}
+		ok &= Report("invert", n, BatchIsaName((BatchIsa)isa), ns, gmtl_ns, err);
+	}
+	return ok;
+}
+
+//|____________________________________________________________________
+//|
+//| Function: main
+//|
+//! \return 0 if every kernel agrees with gmtl, 1 otherwise.
+//|____________________________________________________________________
+
+int main(int argc, char** argv)
+{
+	srand(1234);
+
+	printf("Detected kernel set: %s\n", BatchIsaName(DetectBatchIsa()));
+	printf("%-8s %8s  %-6s %12s  %7s\n", "op", "batch", "impl", "time/elem", "speedup");
+
+	bool ok = true;
+	for (size_t s = 0; s < sizeof(BATCH_SIZES) / sizeof(BATCH_SIZES[0]); s++) {
+		const size_t n = BATCH_SIZES[s];
+		ok &= BenchPoints(n);
+		ok &= BenchVectors(n);
+		ok &= BenchCompose(n);
+		ok &= BenchInvert(n);
+	}
+
+	printf("%s\n", ok ? "All kernels agree with gmtl." : "Some kernels DISAGREE with gmtl.");
+	return ok ? 0 : 1;
+}